@@ -0,0 +1,231 @@
+//
+//  bench.c
+//  Text Editor
+//
+//  Created by Simionescu Teodor on 29.07.2022.
+//
+
+/*
+  --->micro and macro benchmarks of the editor core, without a terminal.
+      usage: kilo_bench [size in MB ...] > bench.json
+ */
+
+/* includes */
+
+#include "kilo.h"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/*defines*/
+
+#define BENCH_SCREEN_ROWS 48
+#define BENCH_SCREEN_COLS 160
+#define BENCH_TYPED_KEYS 20000
+#define BENCH_FRAMES 2000
+
+/*data*/
+
+int bench_results=0; //--objects printed so far, for the commas
+
+/* front end */
+
+void die(const char *s){
+    perror(s);
+    exit(1);
+}
+
+char *editorPrompt(char *prompt, void (*callback)(char *, int)){
+    (void)prompt;
+    (void)callback;
+    return NULL; //--as if ESC was pressed
+}
+
+int editorProgress(){
+    return 0;
+}
+
+/* timing */
+
+long long benchNs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+/*
+ -->one JSON object per measurement: what ran, on how big a file, how many
+    operations and how long they took in total
+ */
+void benchReport(const char *name, int size_mb, long long ops, long long ns, long long bytes){
+    printf("%s\n    {\"name\": \"%s\", \"size_mb\": %d, \"lines\": %d, \"ops\": %lld, "
+           "\"ns\": %lld, \"ns_per_op\": %.1f, \"bytes\": %lld}",
+           bench_results++ ? "," : "", name, size_mb, E.numrows, ops, ns,
+           ops ? (double)ns/ops : 0.0, bytes);
+    fflush(stdout);
+    fprintf(stderr, "%-16s %5d MB %12lld ops %14.1f ns/op\n", name, size_mb, ops,
+            ops ? (double)ns/ops : 0.0);
+}
+
+/* synthetic input */
+
+unsigned long long bench_rng=88172645463325252ULL;
+
+unsigned benchRand(unsigned n){
+    bench_rng ^= bench_rng << 13; //--xorshift64, the same file every run
+    bench_rng ^= bench_rng >> 7;
+    bench_rng ^= bench_rng << 17;
+    return bench_rng % n;
+}
+
+/*
+ -->C-ish text so that every highlighting rule gets some work: keywords,
+    numbers, strings, line comments and tabs. Comment blocks are rare, an
+    unclosed one runs on for a long way as it would in real code.
+ */
+void benchMakeFile(const char *path, int size_mb){
+    FILE *fp = fopen(path, "w");
+    if(!fp) die("fopen");
+
+    static const char *lines[] = {
+        "\tint value%u = %u;",
+        "\tif(count > %u) return %u;",
+        "\tprintf(\"row %u of %u\\n\");",
+        "\t\tfor(int j=0; j<%u; j++) total += %u; // sum",
+        "struct item%u { long next; double w; char name[%u]; };",
+        "",
+    };
+    long long want = (long long)size_mb*1024*1024;
+    long long written = 0;
+    while(written < want){
+        int n;
+        if(benchRand(65536) == 0)
+            n = fprintf(fp, "/* block %u\n   still inside the block */", benchRand(1000));
+        else
+            n = fprintf(fp, lines[benchRand(6)], benchRand(100000), benchRand(1000));
+        fputc('\n', fp);
+        written += n+1;
+    }
+    fclose(fp);
+}
+
+void benchRemove(const char *path){
+    char side[512];
+    unlink(path);
+    snprintf(side, sizeof(side), "%s.kindex", path);
+    unlink(side);
+    snprintf(side, sizeof(side), "%s.kjournal", path);
+    unlink(side);
+}
+
+/* benchmarks */
+
+void benchOpen(const char *path, int size_mb){
+    struct stat st;
+    stat(path, &st);
+
+    long long t = benchNs();
+    editorOpen((char *)path); //--first open, writes the index cache of big files
+    benchReport("open", size_mb, 1, benchNs()-t, st.st_size);
+    editorCloseFile();
+
+    t = benchNs();
+    editorOpen((char *)path);
+    benchReport("open_cached", size_mb, 1, benchNs()-t, st.st_size);
+}
+
+void benchTyping(int size_mb){
+    E.cy = E.numrows/2;
+    E.cx = 0;
+    long long t = benchNs();
+    for(int k=0; k<BENCH_TYPED_KEYS; k++){
+        editorUndoBeginKey();
+        if(k%64 == 63) editorInsertNewline();
+        else editorInsertChar("abcdefghij klmnopqrstuvwxyz;(){}"[k%32]);
+        editorUndoEndKey();
+    }
+    benchReport("typing", size_mb, BENCH_TYPED_KEYS, benchNs()-t, 0);
+
+    t = benchNs();
+    for(int k=0; k<BENCH_TYPED_KEYS; k++){
+        editorUndoBeginKey();
+        editorDelChar();
+        editorUndoEndKey();
+    }
+    benchReport("backspace", size_mb, BENCH_TYPED_KEYS, benchNs()-t, 0);
+}
+
+void benchCascade(int size_mb){
+    //--an unclosed /* on the first row re-highlights every row below it
+    E.cy = 0;
+    E.cx = 0;
+    long long t = benchNs();
+    editorInsertChar('/');
+    editorInsertChar('*');
+    benchReport("cascade_open", size_mb, 1, benchNs()-t, 0);
+
+    t = benchNs();
+    editorDelChar();
+    editorDelChar();
+    benchReport("cascade_close", size_mb, 1, benchNs()-t, 0);
+}
+
+void benchFind(int size_mb){
+    //--a query that is nowhere makes editorFind walk every row once
+    char query[] = "no such text in the file";
+    long long t = benchNs();
+    editorFindCallback(query, 'x');
+    benchReport("find_miss", size_mb, 1, benchNs()-t, 0);
+    editorFindCallback(query, '\r');
+}
+
+void benchFrames(int size_mb){
+    long long bytes = 0;
+    long long t = benchNs();
+    for(int k=0; k<BENCH_FRAMES; k++){
+        struct abuf ab = ABUF_INIT;
+        E.cy = (long long)E.numrows*k/BENCH_FRAMES;
+        editorDrawFrame(&ab);
+        bytes += ab.len;
+        abFree(&ab);
+    }
+    benchReport("frame", size_mb, BENCH_FRAMES, benchNs()-t, bytes/BENCH_FRAMES);
+}
+
+/*** init ***/
+
+int main(int argc, char *argv[]) {
+    int defaults[] = {10, 100, 1000};
+    int nsizes = argc>1 ? argc-1 : 3;
+    const char *tmp = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+
+    initEditor();
+    E.screenrows = BENCH_SCREEN_ROWS;
+    E.screencols = BENCH_SCREEN_COLS;
+
+    printf("{\n  \"version\": \"%s\",\n  \"results\": [", KILO_VERSION);
+    for(int k=0; k<nsizes; k++){
+        int size_mb = argc>1 ? atoi(argv[k+1]) : defaults[k];
+        if(size_mb <= 0) continue;
+
+        char path[256];
+        snprintf(path, sizeof(path), "%s/kilo_bench_%d.c", tmp, size_mb);
+        benchRemove(path);
+        benchMakeFile(path, size_mb);
+
+        benchOpen(path, size_mb);
+        benchTyping(size_mb);
+        benchCascade(size_mb);
+        benchFind(size_mb);
+        benchFrames(size_mb);
+
+        E.dirty = 0;
+        editorCloseFile();
+        benchRemove(path);
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
@@ -7,137 +7,111 @@
 
 /* includes */
 
-#define _DEFAULT_SOURCE
-#define _BSD_SOURCE
-#define _GNU_SOURCE
+#include "kilo.h"
 
 #include <unistd.h>
 #include <termios.h>
 #include <stdlib.h>
 #include <string.h>
-#include <fcntl.h>
-#include <sys/types.h>
 #include <errno.h>
 #include <sys/ioctl.h>
 #include <ctype.h>
-#include <stdarg.h>
 #include <time.h>
-#include <stdio.h>
-
-/*defines*/
-/*
-  --->terminate key == Q !!!!!
- */
-#define KILO_VERSION "0.0.1"
-#define KILO_TAB_STOP 8
-#define KILO_QUIT_TIMES 3
-
-#define SHIFT_Q(k) ((k) & 0x51) // end
-#define CTRL_KEY(k) ((k) & 0x1f)
-
-enum editorKey{ // using int type with a high value to avoid confussion with chars
-    FIND_KEY=70,
-    SAVE_KEY=83, //save key
-    BACKSPACE=127,
-    ARROW_RIGHT = 1000,
-    ARROW_LEFT ,
-    ARROW_UP ,
-    ARROW_DOWN,
-    DEL_KEY,
-    HOME_KEY,
-    END_KEY,
-    PAGE_UP,
-    PAGE_DOWN
-};
-
-enum editorHighlight{
-    HL_NORMAL=0,
-    HL_COMMENT,
-    HL_MLCOMMENT,
-    HL_KEYWORD1,
-    HL_KEYWORD2,
-    HL_STRING,
-    HL_NUMBER,
-    HL_MATCH
-};
-
-#define HL_HIGHLIGHT_NUMBERS (1<<0)
-#define HL_HIGHLIGHT_STRING (1<<1)
+#include <stdint.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
 
 /*data*/
 
-struct editorSyntax{ //--used for highlighting
-    char *filetype;
-    char **filematch;
-    char **keywords;
-    char *singleline_comment_start;
-    char *multiline_comment_start;
-    char *multiline_comment_end;
-    int flags;
-};
+struct termios orig_termios;
 
-typedef struct erow{ //editor row -> storest a line of text as a pointer to the dynamically-allocated character data and length.
-    int idx;
-    int size;
-    int rsize;
-    char *chars;
-    char *render;
-    unsigned char *hl;
-    int hl_open_comment;
-}erow;
-
-struct editorConfig{ //--global editor struct
-    int cx, cy; //coordonates for x and y on the terminal
-    int rx; //coordonate for showing TABS/etc
-    int rowoff; //vertical scrolling
-    int coloff; //horizontal scrolling
-    int screenrows;
-    int screencols;
-    int numrows;
-    erow *row;
-    int dirty;
-    char *filename;
-    char statusmsg[80];
+struct editorBatch{ //--keys come from a script instead of the terminal
+    int on;
+    int *keys; //--keys of the script operation being replayed
+    int nkeys;
+    int pos;
+    int stop; //--Q was replayed, the rest of the script is skipped for this file
+};
+struct editorBatch B;
+#define BATCH_LITERAL 0x10000 //--on a script key: insert it as text, whatever command it is elsewhere
+
+typedef struct remoteMsg{ //--client to server, same host so native byte order
+    int32_t type; //--'K' key a, 'W' window of a rows and b columns, 'O' open a path of a bytes that follows
+    int32_t a, b;
+}remoteMsg;
+
+typedef struct editorClient{ //--a terminal attached to the server, with a view of its own
+    int fd;
+    int buffer; //--index into E.buffers
+    int cx, cy, rx;
+    int rowoff, coloff, segoff;
+    int screenrows, screencols;
+    char statusmsg[sizeof(E.statusmsg)];
     time_t statusmsg_time;
-    struct editorSyntax *syntax;
-    struct termios orig_termios;
+    int *keys; //--received and not handled yet
+    int nkeys, capkeys, pos;
+    char in[sizeof(remoteMsg)+PATH_MAX]; //--a message not received in full yet
+    int inlen;
+    struct abuf *lines; //--the frame it shows, to send only what changed
+    int nlines;
+    int quit;
+    int waiting; //--in a prompt further down the stack: its keys are only queued
+}editorClient;
+
+struct editorServer{
+    int on;
+    int fd;
+    char *path;
+    editorClient **clients; //--pointers, a client waiting in a prompt must not move
+    int nclients;
+    editorClient *current; //--the one whose view is in E
+    int depth; //--rounds running inside a prompt's wait, clients are dropped at 0 only
 };
-struct editorConfig E;
-
-/* filetypes */
+struct editorServer S;
+volatile sig_atomic_t server_stop;
 
-char *C_HL_extensions[] = {".c", ".cpp", ".h", NULL};
-
-char *C_HL_keywords[]={
-    "switch", "if", "while", "for", "break", "continue", "return", "else",
-    "struct", "union", "typedef", "static", "enum", "class", "case",
-    
-    "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|", "void|", NULL
+struct frameView{ //--what decides if a frame is more than the cursor moving
+    int rowoff, coloff, segoff;
+    size_t hextop;
+    int numrows, dirty, current;
+    time_t statusmsg_time;
 };
 
-struct editorSyntax HDLB[] = { //--hl database for C language
-    {
-        "c", //filetype
-        C_HL_extensions, //the extensions
-        C_HL_keywords,
-        "//", "/*", "*/",
-        HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRING //flag field
-    },
+struct editorFrames{ //--when the terminal front end draws
+    long long last; //--ms the last frame was written at
+    long long interval; //--ms between frames that change the text, grows while the terminal lags
+    struct frameView shown; //--the view of the last frame
+    struct abuf *lines; //--the terminal lines it shows, only changed ones are written
+    int nlines;
 };
-
-#define HDLB_ENTRIES (sizeof(HDLB)/sizeof(HDLB[0]))
+struct editorFrames F={0, KILO_FRAME_MS, {0}, NULL, 0};
 
 /*prototypes*/
 
-void editorSetStatusMessage(const char *fmt, ...);
 void editorRefreshScreen();
-char *editorPrompt(char *prompt, void (*callback)(char*, int));
+struct frameView editorFrameView();
+void editorProcessKeypress();
+int editorInputPending(int ms);
+int editorBatchKey();
+int editorReadEscape();
+int editorServerKey();
+void editorServerFrame(editorClient *c);
+int editorServerShared();
+void editorServerRound();
+void editorServerClosed(int closing);
+int editorWriteAll(int fd, const char *s, int len);
 
 /*terminal*/
 
 void die(const char *s){ //EH
-    write(STDOUT_FILENO, "\x1b[2J", 4);
-    write(STDOUT_FILENO, "\x1b[H", 3);
+    if(!B.on && !S.on){
+        write(STDOUT_FILENO, "\x1b[2J", 4);
+        write(STDOUT_FILENO, "\x1b[H", 3);
+    }
     
     perror(s);
     exit(1);
@@ -147,12 +121,12 @@ void disableRawMode(){
     /*
      -->get the terminal back to normal
      */
-    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1)
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios) == -1)
         die("tcsetattr");
 }
 
 void enableRawMode(){
-    if (tcgetattr(STDIN_FILENO, &E.orig_termios) == -1) die("tcgetattr");
+    if (tcgetattr(STDIN_FILENO, &orig_termios) == -1) die("tcgetattr");
     /*
      -->now assure that after at the ending of this program the
         terminal comes back to normal
@@ -162,7 +136,7 @@ void enableRawMode(){
     /*
      -->takes everithing from terminal
      */
-    struct termios raw=E.orig_termios;
+    struct termios raw=orig_termios;
     /*
      -->deactivate all the safety macros, makes the terminal 'RAW'
      */
@@ -177,52 +151,60 @@ void enableRawMode(){
 }
 
 int editorReadKey() {
+    if(B.on) return editorBatchKey();
+    if(S.on) return editorServerKey();
+    
     int nread;
     char c;
     while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
         if (nread == -1 && errno != EAGAIN) die("read");
+        editorJournalSync(); //--idle: commit whatever the last keys logged
+        if(editorFollowPoll()) editorRefreshScreen();
     }
     
-    if(c=='\x1b'){
-        char seq[3];
-        
-        if(read(STDIN_FILENO, &seq[0], 1)!= 1) return '\x1b';
-        if(read(STDIN_FILENO, &seq[1], 1)!= 1) return '\x1b';
-        if(seq[0]=='['){
-            if(seq[1]>='0' && seq[1]<='9'){
-                if(read(STDIN_FILENO, &seq[2], 1)!=1) return '\x1b';
-                if(seq[2]=='~'){
-                    switch(seq[1]){
-                        case '1': return HOME_KEY;
-                        case '3': return DEL_KEY;
-                        case '4': return END_KEY;
-                        case '5': return PAGE_UP;
-                        case '6': return PAGE_DOWN;
-                        case '7': return HOME_KEY;
-                        case '8': return END_KEY;
-                    }
-                }
-            }else{
+    long long t = LATENCY_BEGIN(); //--from the first byte on, the wait is not ours
+    int key = (c=='\x1b') ? editorReadEscape() : c;
+    LATENCY_END(PROBE_READ_KEY, t);
+    return key;
+}
+
+int editorReadEscape(){ //--the ESC is read, what follows tells the key
+    char seq[3];
+    
+    if(read(STDIN_FILENO, &seq[0], 1)!= 1) return '\x1b';
+    if(read(STDIN_FILENO, &seq[1], 1)!= 1) return '\x1b';
+    if(seq[0]=='['){
+        if(seq[1]>='0' && seq[1]<='9'){
+            if(read(STDIN_FILENO, &seq[2], 1)!=1) return '\x1b';
+            if(seq[2]=='~'){
                 switch(seq[1]){
-                    case 'A': return ARROW_UP;
-                    case 'B': return ARROW_DOWN;
-                    case 'C': return ARROW_RIGHT;
-                    case 'D': return ARROW_LEFT;
-                    case 'H': return HOME_KEY;
-                    case 'F': return END_KEY;
+                    case '1': return HOME_KEY;
+                    case '3': return DEL_KEY;
+                    case '4': return END_KEY;
+                    case '5': return PAGE_UP;
+                    case '6': return PAGE_DOWN;
+                    case '7': return HOME_KEY;
+                    case '8': return END_KEY;
                 }
             }
-        } else if (seq[0] == 'O'){
+        }else{
             switch(seq[1]){
+                case 'A': return ARROW_UP;
+                case 'B': return ARROW_DOWN;
+                case 'C': return ARROW_RIGHT;
+                case 'D': return ARROW_LEFT;
                 case 'H': return HOME_KEY;
                 case 'F': return END_KEY;
             }
         }
-        
-        return '\x1b';
-    }else{
-        return c;
+    } else if (seq[0] == 'O'){
+        switch(seq[1]){
+            case 'H': return HOME_KEY;
+            case 'F': return END_KEY;
+        }
     }
+    
+    return '\x1b';
 }
 
 int getCursorPosition(int *rows, int *cols){
@@ -258,670 +240,119 @@ int getWindowSize(int *rows, int *cols){
     }
 }
 
-/* syntax highlighting*/
-
-int is_separator(int c){
-    return isspace(c) || c=='\0' || strchr(",.()+-/*=~%<>[];", c) !=NULL;
-}
-
-void editorUpdateSyntax(erow *row){
-    row->hl = realloc(row->hl, row->size);
-    memset(row->hl, HL_NORMAL, row->rsize);//--an unlighted charachter will have a
-    //value of HL_NORMAL in hl
-    
-    if(E.syntax == NULL) return;
-    
-    char **keywords = E.syntax->keywords; //alias
-    
-    char *scs = E.syntax->singleline_comment_start; //alias
-    char *mcs =E.syntax->multiline_comment_start;
-    char *mce =E.syntax->multiline_comment_end;
-    
-    int scs_len= scs ? strlen(scs) : 0;
-    int mcs_len= mcs ? strlen(mcs) : 0;
-    int mce_len= mce ? strlen(mce) : 0;
-    
-    int prev_step=1; //--the begginig of a line is a separator
-    int in_string=0;
-    int in_comment=(row->idx >0 && E.row[row->idx-1].hl_open_comment);//--boolean to keep track if we are in a multiline comment. True if the previous line has unclosed multiline comment
-    
-    int i=0;
-    while(i<row->rsize){
-        char c=row->render[i];
-        unsigned char prev_hl = (i>0)? row->hl[i-1] : HL_NORMAL;
-        
-        //--decide if we should hl single-line comments and also check if we re not in a string
-        if(scs_len && !in_string && !in_comment){
-            if(!strncmp(&row->render[i], scs, scs_len)){
-                memset(&row->hl[i], HL_COMMENT, row->rsize-1);
-                break;
-            }
-        }
-        
-        //--both should be non NULL to hl a multicomment. Is necessary to not be in a string
-        if(mcs_len && mce_len && !in_string){
-            if(in_comment){
-                //--if we're inside a multiline comment, just hl the content
-                row->hl[i] = HL_MLCOMMENT;
-                //--checking the final state of the multiline comment
-                if(!strncmp(&row->render[i], mce, mce_len)){
-                    //--if so, hl the whole mce stirng
-                    memset(&row->hl[i], HL_MLCOMMENT, mce_len);
-                    i+=mce_len; //--consume it
-                    in_comment=0;
-                    prev_step=1;
-                    continue;
-                }else{ //--if we're not at the end, simply consume the current character
-                    i++;
-                    continue;
-                }
-            }else if(!strncmp(&row->render[i], mcs, mcs_len)){
-                //--we're at the start of a multiline comment
-                memset(&row->render[i], HL_MLCOMMENT, mcs_len);
-                i+=mcs_len;
-                in_comment=1;
-                continue;
-            }
-        }
-        
-        if(E.syntax->flags & HL_HIGHLIGHT_STRING){
-            //--if set, the current character can be hl with HL_STRING
-            //if not, check if we're at the beggining of a string by checking single/double quote
-            if(in_string){
-                //--if we're in a string and the current ch is a backslach \ and
-                //there is at least one more ch line afte \, we highlight the ch that comes afte \.
-                row->hl[i]=HL_STRING;
-                if(c=='\\' && i+1<row->rsize){
-                    row->hl[i+1] =HL_STRING;
-                    i+=2;
-                    continue;
-                }
-                //--if the current character is closing quote, reset the in_string
-                if(c==in_string) in_string=0;
-                i++;//--consume the character
-                prev_step = 1; //--closing character is considered a separator
-                continue;
-            }else{
-                if(c=='"' || c=='\''){
-                    in_string = c;
-                    row->hl[i]=HL_STRING;
-                    i++;
-                    continue;
-                }
-            }
-        }
-        
-        //--check if the numbers should be hl in this text
-        if(E.syntax->flags & HL_HIGHLIGHT_NUMBERS){
-            //--to highlight a digit is required that the prev character is either a separator
-            //or to be already highlighted
-            if((isdigit(c) && (prev_step || prev_hl == HL_NUMBER)) ||
-               (c=='.' && prev_hl==HL_NUMBER)){
-                row->hl[i] = HL_NUMBER;
-                i++; //--consume the character
-                prev_step=0; //--this indicate that we are in the middle of highlighting something
-                continue;
-            }
-        }
-        
-        //--only if a separator came before, then we can consider a data type
-        if(prev_step){
-            int j;
-            for(j=0; keywords[j]; j++){
-                int klen = strlen(keywords[j]);
-                int kw2 = keywords[j][klen-1]=='|';
-                if(kw2) klen--;
-                
-                //--check if a keyword exists at our position in the text and we check
-                //to see if a separator character comes after the keyword
-                if(!strncmp(&row->render[i], keywords[j], klen) &&
-                   is_separator(row->render[i+klen])){
-                    //--passed, meaning that we have a word to hl
-                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
-                    i+=klen; //--consume the entire keyword
-                    break;
-                }
-            }
-            if(keywords[j]!=NULL){
-                prev_step=0;
-                continue; //if the for loop broke
-            }
-        }
-        
-        prev_step=is_separator(c);
-        i++;
-    }
-    
-    int changed =(row->hl_open_comment != in_comment);
-    row->hl_open_comment = in_comment; //--tells if the row ended as an unclosed multiline comment or not
-    //--if there is a next line and the state of hl_open_comment changed, call again
-    if(changed && row->idx+1 < E.numrows)
-        editorUpdateSyntax(&E.row[row->idx+1]);
-}
+/*** output ***/
 
-int editorSyntaxToColor(int hl){
-    switch (hl) {
-        case HL_COMMENT:
-        case HL_MLCOMMENT:
-            return 36; //--cyan
-        case HL_KEYWORD1:
-            return 33; //--yellow
-        case HL_KEYWORD2:
-            return 32; //--green
-        case HL_STRING:
-            return 35; //--magneta
-        case HL_NUMBER:
-            return 31;
-        case HL_MATCH:
-            return 34;
-        default:
-            return 37;
+void editorRefreshScreen() {
+    if(B.on) return; //--nobody is looking
+    if(S.on){
+        editorServerFrame(S.current);
+        return;
     }
-}
-
-void editorSelectSyntaxHighlight(){
-    E.syntax = NULL; //--if nothing matches there will be no filename/filetype
-    if(E.filename == NULL) return;
     
-    char *ext = strrchr(E.filename, '.'); //--last position of '.' in filename
-    
-    for(unsigned int j=0; j<HDLB_ENTRIES; j++){
-        struct editorSyntax *s= &HDLB[j];
-        unsigned int i=0;
-        while(s->filematch[i]){
-            int is_ext= (s->filematch[i][0] == '.'); //--if is a file extension
-            //--if the file ends with the same extension or at least if
-            //the pattern exists anywhere in the filename
-            if((is_ext && ext && !strcmp(ext, s->filematch[i])) ||
-               (!is_ext && strstr(E.filename, s->filematch[i]))){
-                E.syntax = s;
-                
-                //--the hl immediately changes when the filetype changes
-                int filerow;
-                for(filerow=0; filerow< E.numrows; filerow++){
-                    editorUpdateSyntax(&E.row[filerow]);
-                }
-                
-                return;
-            }
-            i++;
-        }
-    }
-}
-
-/* row operations*/
-
-int editorRowCxToRx(erow *row, int cx){
-    int rx=0;
-    int j;
-    for(j=0;j<cx; j++){
-        if(row->chars[j]=='\t') // if we are on a tab character, we're going right in the back of the next TAB character
-            rx+=(KILO_TAB_STOP-1)-(rx%KILO_TAB_STOP);
-        rx++;
-    }
-    return rx;
-}
-
-int editorRowRxtoCx(erow *row, int rx){
-    int cur_rx = 0;
-    int cx;
-    for(cx=0; cx<row->size; cx++){
-        if(row->chars[cx] == '\t')
-            cur_rx += (KILO_TAB_STOP -1) - (cur_rx%KILO_TAB_STOP);
-        cur_rx++;
-        
-        if(cur_rx >rx) return cx;
-    }
-    return cx;
+    struct abuf ab = ABUF_INIT;
+    editorDrawFrameDiff(&ab, &F.lines, &F.nlines);
+    long long t = LATENCY_BEGIN();
+    write(STDOUT_FILENO, ab.b, ab.len);
+    LATENCY_END(PROBE_WRITE, t);
+    editorLatencyFrame(ab.len);
+    abFree(&ab);
+    F.last = editorMonotonicMs();
+    F.shown = editorFrameView();
 }
 
-void editorUpdateRow(erow *row){
-    free(row->render);
-    row->render = malloc(row->size +1);
-    
-    int tabs=0;
-    int j;
-    for(j=0; j<row->size; j++)
-        if(row->chars[j]=='\t') tabs++;
-    
-    free(row->render);
-    row->render=malloc(row->size+tabs*(KILO_TAB_STOP-1)+1);
-    
-    int idx=0;
-    for(j=0; j<row->size; j++){
-        if(row->chars[j]=='\t'){
-            row->render[idx++]=' ';
-            while(idx% KILO_TAB_STOP !=0) row->render[idx++] = ' ';
-        }else{
-            row->render[idx++]=row->chars[j];
-        }
+/*
+ -->the buffer just switched to as it was left, until its real frame is built
+ */
+void editorShowCachedFrame(){
+    struct abuf *f = &E.buffers[E.current].frame;
+    if(B.on || !E.nbuffers || !f->len) return;
+    if(S.on){ //--to the client that switched, not the server's terminal
+        if(editorWriteAll(S.current->fd, f->b, f->len)==-1) S.current->quit=1;
+        editorDrawFrameSeed(f, &S.current->lines, &S.current->nlines);
+        return;
     }
-    row->render[idx]='\0';
-    row->rsize=idx;
-    
-    editorUpdateSyntax(row); //makes sense to update the hl array here
-}
-
-void editorInsertRow(int at, char *s, size_t len){
-    if(at<0 || at> E.numrows) return;
-    
-    E.row = realloc(E.row, sizeof(erow)*(E.numrows+1));
-    memmove(&E.row[at+1], &E.row[at], sizeof(erow)*(E.numrows-at));
-    for(int j=at+1; j<E.numrows; j++) E.row[j].idx++;
-    
-    E.row[at].idx=at; //--initialize to the rows index in the file at the time is inserted
-    
-    E.row[at].size = len;
-    E.row[at].chars = malloc(len+1);
-    memcpy(E.row[at].chars, s, len);
-    E.row[at].chars[len] = '\0';
-    
-    E.row[at].rsize=0;
-    E.row[at].render=NULL;
-    E.row[at].hl=NULL;
-    E.row[at].hl_open_comment=0;
-    editorUpdateRow(&E.row[at]);
-    
-    E.numrows++;
-    E.dirty++;
-}
-
-void editorFreeRow(erow *row){
-    free(row->render);
-    free(row->chars);
-    free(row->hl);
-}
-
-void editorDelRow(int at){
-    if(at<0 || at>=E.numrows) return;
-    editorFreeRow(&E.row[at]);
-    memmove(&E.row[at], &E.row[at+1], sizeof(erow)*(E.numrows-at-1));
-    for(int j=at; j<E.numrows-1; j++) E.row[j].idx--;
-    E.numrows--;
-    E.dirty++;
+    write(STDOUT_FILENO, f->b, f->len);
+    editorDrawFrameSeed(f, &F.lines, &F.nlines); //--the next frame is a diff against it
 }
 
-void editorRowInsertChar(erow *row, int at, int c){
-    if( at<0 || at > row->size) at= row->size;
-    row->chars = realloc(row->chars, row->size*2);
-    memmove(&row->chars[at+1], &row->chars[at], row->size-at+1);
-    row->size++;
-    row->chars[at]=c;
-    editorUpdateRow(row); //update render & rsize
-    E.dirty++;
-}
-
-void editorRowAppendString(erow *row, char *s, size_t len){
-    row->chars = realloc(row->chars, row->size+len+1);
-    memcpy(&row->chars[row->size], s, len);
-    row->size+=len;
-    row->chars[row->size]='\0';
-    editorUpdateRow(row);
-    E.dirty++;
-}
-
-void editorRowDelChar(erow *row, int at){
-    if(at<0 || at>=row->size) return;
-    memmove(&row->chars[at], &row->chars[at+1],row->size-at);
-    row->size--;
-    editorUpdateRow(row);
-    E.dirty++;
+/*
+ -->between steps of a long job, like a grep: draws what it has so far and
+    takes the keys typed meanwhile, ESC among them stops it
+ */
+int editorProgress(){
+    editorRefreshScreen();
+    int stop=0;
+    while(editorInputPending(0))
+        if(editorReadKey()=='\x1b') stop=1;
+    return stop;
 }
 
-/*editor Operations*/
+/* frame scheduling */
 
-void editorInsertChar(int c){
-    if(E.cy == E.numrows) editorInsertRow(E.numrows, "", 0); //finale line
-    editorRowInsertChar(&E.row[E.cy], E.cx, c);
-    E.cx++;
+int editorInputPending(int ms){ //--a key arrives within ms, 0 only looks
+    if(B.on || S.on) return 0; //--their keys are not on stdin
+    struct pollfd p={STDIN_FILENO, POLLIN, 0};
+    return poll(&p, 1, ms) > 0;
 }
 
-void editorInsertNewline(){
-    if(E.cx==0){
-        editorInsertRow(E.cy, "", 0);
-    }else{
-        erow *row=&E.row[E.cy];
-        editorInsertRow(E.cy+1, &row->chars[E.cx], row->size-E.cx);
-        row=&E.row[E.cy];
-        row->size=E.cx;
-        row->chars[row->size]='\0';
-        editorUpdateRow(row);
-    }
-    E.cy++;
-    E.cx=0;
-}
-
-void editorDelChar(){
-    if(E.cy==E.numrows) return;
-    if(E.cx==0 && E.cy==0) return;
-    
-    erow *row = &E.row[E.cy];
-    if(E.cx>0){
-        editorRowDelChar(row, E.cx-1);
-        E.cx--;
-    }else{
-        E.cx =E.row[E.cy-1].size;
-        editorRowAppendString(&E.row[E.cy-1], row->chars, row->size);
-        editorDelRow(E.cy);
-        E.cy--;
-    }
+int editorOutputQueued(){ //--bytes of earlier frames the terminal has not taken yet
+    int n=0;
+#ifdef TIOCOUTQ
+    if(ioctl(STDOUT_FILENO, TIOCOUTQ, &n) == -1) n=0;
+#endif
+    return n;
 }
 
-/*file i/o*/
-
-char *editorRowtoString(int *buflen){
-    int totlen=0;
-    int j;
-    for(j=0; j<E.numrows;j++)
-        totlen += E.row[j].size +1;
-    *buflen = totlen;
-    
-    char *buf = malloc(totlen);
-    char *p=buf;
-    for(j=0;j<E.numrows; j++){
-        memcpy(p, E.row[j].chars, E.row[j].size);
-        p+=E.row[j].size;
-        *p='\n';
-        p++;
-    }
-    
-    return buf;
+struct frameView editorFrameView(){
+    editorScroll(); //--the offsets the next frame will have
+    struct frameView v={E.rowoff, E.coloff, E.view.segoff, E.hex.top,
+                        E.numrows, E.dirty, E.current, E.statusmsg_time};
+    return v;
 }
 
-void editorOpen(char *filename){
-    free(E.filename);
-    E.filename= strdup(filename);
-    
-    editorSelectSyntaxHighlight();
-    
-    FILE *fp= fopen(filename, "r");
-    if(!fp) die("fopen");
-    
-    char *line= NULL;
-    size_t linecap=0;
-    ssize_t linelen;
-    while((linelen = getline(&line, &linecap, fp))!= -1){
-        while(linelen>0 && (line[linelen-1]=='\n' || line[linelen-1]=='\r'))
-            linelen--;
-        editorInsertRow(E.numrows, line, linelen);
-    }
-    
-    free(line);
-    fclose(fp);
-    E.dirty=0;
-}
-
-void editorSave(){
-    if(E.filename==NULL){
-        E.filename=editorPrompt("Save as: %s (ESC to cancel)", NULL);
-        if(E.filename==NULL){
-            editorSetStatusMessage("Save aborted");
-            return;
-        }
-        editorSelectSyntaxHighlight();
-    }
-    
-    int len;
-    char *buf=editorRowtoString(&len);
-    
-    int fd= open(E.filename, O_RDWR | O_CREAT, 0644);
-    if(fd!=-1){
-        if((ftruncate(fd, len))!=-1){
-            if((write(fd, buf, len))==len){
-                close(fd);
-                free(buf);
-                E.dirty=0;
-                editorSetStatusMessage("%d bytes written to disk", len);
-                return;
-            }
-        }
-        close(fd);
-    }
-    free(buf);
-    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+/*
+ -->a frame that only moves the cursor writes the status bar and a cursor
+    position, cheap enough to never be held back
+ */
+int editorFrameCursorOnly(){
+    struct frameView v=editorFrameView(), *w=&F.shown;
+    return v.rowoff==w->rowoff && v.coloff==w->coloff && v.segoff==w->segoff &&
+           v.hextop==w->hextop && v.numrows==w->numrows && v.dirty==w->dirty &&
+           v.current==w->current && v.statusmsg_time==w->statusmsg_time;
 }
 
-/* find */
-
-void editorFindCallback(char *query, int key){
-    static int last_match = -1;
-    static int direction = 1;
-    
-    static int saved_hl_line;
-    static char *saved_hl=NULL;
-    
-    if(saved_hl){
-        memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-        free(saved_hl);
-        saved_hl=NULL;
-    }
-    
-    if(key=='\r' || key=='\x1b'){
-        last_match = -1;
-        direction =1;
-        return;
-    }
-    else if(key == ARROW_RIGHT || key ==ARROW_DOWN) direction =1;
-    else if(key ==ARROW_LEFT || key ==ARROW_UP) direction =-1;
-    else{
-        last_match =-1;
-        direction =1;
-    }
+/*
+ -->called after a key was handled. Every key already waiting is handled
+    too before anything is drawn, so key repeat or a slow link catching up
+    costs one frame instead of one per key. A frame that changes the text
+    waits for F.interval after the last one, or while the terminal still
+    holds output of earlier frames; keys that come meanwhile go into the
+    same frame, the ones it would have shown were stale anyway. The wait
+    doubles while the terminal lags and eases back when it keeps up, it
+    never goes past KILO_FRAME_MAX_MS.
+ */
+void editorScheduleFrame(){
+    long long start = editorMonotonicMs();
+    while(editorInputPending(0) && editorMonotonicMs()-start < KILO_FRAME_MAX_MS)
+        editorProcessKeypress();
     
-    if(last_match ==-1) direction =1;
-    int current = last_match;
-    int i;
-    for(i=0; i<E.numrows; i++){
-        current += direction;
-        if(current==-1) current = E.numrows-1;
-        else if(current == E.numrows) current=0;
+    int lagged=0;
+    while(1){
+        long long now = editorMonotonicMs();
+        int queued = editorOutputQueued();
+        lagged |= queued>0;
+        if(now-start >= KILO_FRAME_MAX_MS) break;
+        if(!queued && (editorFrameCursorOnly() || now-F.last >= F.interval)) break;
         
-        erow *row = &E.row[current];
-        char *match = strstr(row->render, query);
-        if(match){
-            last_match = current;
-            E.cy =current;
-            E.cx = editorRowRxtoCx(row, match- row->render);
-            E.rowoff = E.numrows;
-            
-            saved_hl_line= current;
-            saved_hl = malloc(row->rsize);
-            memcpy(saved_hl, row->hl, row->rsize);
-            memset(&row->hl[match-row->render], HL_MATCH, strlen(query));
-            break;
-        }
-    }
-}
-
-void editorFind(){
-    int saved_cx = E.cx;
-    int saved_cy = E.cy;
-    int saved_coloff = E.coloff;
-    int saved_rowoff = E.rowoff;
-    
-    char *query = editorPrompt("Search: %s (Use ESC/Arrows/Enter)", editorFindCallback);
-    
-    if(query) free(query);
-    else{
-        E.cx = saved_cx;
-        E.cy= saved_cy;
-        E.rowoff = saved_rowoff;
-        E.coloff = saved_coloff;
-    }
-}
-
-/*abbend buffer*/
-
-struct abuf{
-    char *b;
-    int len;
-};
-#define ABUF_INIT {NULL, 0}
-
-void abAppend(struct abuf *ab, const char *s, int len){
-    char *new = realloc(ab->b, ab->len + len);
-    
-    if(new==NULL) return;
-    memcpy(&new[ab->len], s, len);
-    ab->b=new;
-    ab->len+=len;
-}
-
-void abFree(struct abuf *ab){
-    free(ab->b);
-}
-
-/*** output ***/
-
-void editorScroll(){
-    E.rx=0;
-    if(E.cy<E.numrows){
-        E.rx=editorRowCxToRx(&E.row[E.cy], E.cx);
+        long long wait = queued ? 1 : F.last+F.interval-now;
+        if(editorInputPending((int)wait)) editorProcessKeypress();
     }
     
-    if(E.cy < E.rowoff){
-        E.rowoff=E.cy;
-    }
-    if(E.cy>=E.rowoff+E.screenrows){
-        E.rowoff = E.cy- E.screenrows + 1;
-    }
-    if(E.rx < E.coloff){
-        E.coloff = E.rx;
-    }
-    if(E.rx >=E.coloff + E.screencols){
-        E.coloff = E.rx - E.screencols+1;
-    }
+    if(lagged) F.interval = F.interval*2 < KILO_FRAME_MAX_MS ? F.interval*2 : KILO_FRAME_MAX_MS;
+    else if(F.interval > KILO_FRAME_MS) F.interval = F.interval*3/4 > KILO_FRAME_MS ? F.interval*3/4 : KILO_FRAME_MS;
+    editorRefreshScreen();
 }
 
-void editorDrawRows(struct abuf *ab){
-    int y;
-    for(y=0; y<E.screenrows; y++){
-        int filerow = y+E.rowoff;
-        if(filerow >= E.numrows){ //if we draw a new row
-            if(E.numrows==0 && y==E.screenrows/3){
-                char welcome[80];
-                int welcomelen = snprintf(welcome, sizeof(welcome),
-                                         "KILO -- version %s", KILO_VERSION);
-                if(welcomelen > E.screencols) welcomelen=E.screencols;
-                int padding = (E.screencols-welcomelen)/2;
-                if(padding){
-                    abAppend(ab, "~", 1);
-                    padding--;
-                }
-                while(padding--) abAppend(ab, " ", 1);
-                abAppend(ab, welcome, welcomelen);
-            } else{
-                abAppend(ab, "~", 1);
-            }
-        } else{ // if we draw a row that is part of the text buffer
-            int len= E.row[filerow].rsize - E.coloff;
-            if(len<0) len =0;
-            if(len>E.screencols) len=E.screencols;
-            char *c = &E.row[filerow].render[E.coloff];
-            unsigned char *hl = &E.row[filerow].hl[E.coloff];
-            int current_color=-1;
-            int j;
-            for(j=0;j<len; j++){
-                //if is a control character
-                if(iscntrl(c[j])){
-                    char sym= (c[j]<=26) ? '@' + c[j] : '?'; //--in ascii, the capital letter
-                    //comes after @
-                    abAppend(ab, "\x1b[7m", 4); //--switch to inverted colors
-                    abAppend(ab, &sym, 1);
-                    abAppend(ab, "\x1b[m", 3); //--turn off inverted colors again
-                    if(current_color !=-1){
-                        char buf[16];
-                        int clen = snprintf ( buf, sizeof(buf), "\x1b[%dm", current_color);
-                        abAppend(ab, buf, clen);
-                    }
-                }else if(hl[j]==HL_NORMAL){
-                    if(current_color!=-1){
-                        abAppend(ab, "\x1b[39m", 5);
-                        current_color=-1;}
-                    abAppend(ab, &c[j], 1);
-                }else{
-                    int color= editorSyntaxToColor(hl[j]);
-                    if(color!=current_color){
-                        current_color= color;
-                        char buf[16];
-                        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-                        abAppend(ab, buf, clen);
-                    }
-                    abAppend(ab, &c[j], 1);
-                }
-            }
-            abAppend(ab, "\x1b[39m", 5);
-        }
-        
-        abAppend(ab, "\x1b[K", 3);
-        if(y<E.screenrows-1){
-            abAppend(ab, "\r\n", 2);
-        }
-    }
-}
-
-void editorDrawStatusBar(struct abuf *ab){
-    abAppend(ab, "\x1b[7m", 4); // text will be printed with inverted colors
-    char status[80], rstatus[80];
-    int len = snprintf(status, sizeof(status), "%.20s- %d lines %s",
-                       E.filename ? E.filename : "[No Name]", E.numrows,
-                       E.dirty ? "modified": "");
-    int rlen= snprintf(rstatus, sizeof(rstatus), "%s | %d/%d",
-                       E.syntax ? E.syntax->filetype : "no ft" ,E.cy+1, E.numrows);
-    if(len > E.screencols) len= E.screencols;
-    abAppend(ab, status, len);
-    while(len < E.screencols){
-        if(E.screencols - len == rlen){
-            abAppend(ab, rstatus, rlen);
-            break;
-        }else{
-            abAppend(ab, " ", 1);
-            len++;
-        }
-    }
-    abAppend(ab, "\x1b[m", 3); // text back to normal
-    abAppend(ab, "\r\n", 2);
-}
-
-void editorDrawMessageBar(struct abuf *ab){
-    abAppend(ab, "\x1b[K", 3);
-    int msglen = strlen(E.statusmsg);
-    if(msglen > E.screencols) msglen = E.screencols;
-    if(msglen && time(NULL)-E.statusmsg_time<5)
-        abAppend(ab, E.statusmsg, msglen);
-}
-
-void editorRefreshScreen() {
-    editorScroll();
-    
-    struct abuf ab = ABUF_INIT;
-    
-    abAppend(&ab, "\x1b[?25l", 6);
-    //abAppend(&ab, "\x1b[2J", 4); //not required anymore, cleaning 1 row at the time
-    abAppend(&ab, "\x1b[H", 3);
-    
-    editorDrawRows(&ab);
-    editorDrawStatusBar(&ab);
-    editorDrawMessageBar(&ab);
-    
-    char buf[32];
-    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy-E.rowoff)+1, (E.rx-E.coloff)+1);
-    abAppend(&ab, buf, strlen(buf));
-    
-    abAppend(&ab, "\x1b[?25h", 6);
-    
-    write(STDOUT_FILENO, ab.b, ab.len);
-    abFree(&ab);
-}
-
-void editorSetStatusMessage(const char *fmt, ...){
-    va_list ap;
-    va_start (ap, fmt);
-    vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
-    va_end(ap);
-    E.statusmsg_time= time(NULL);
-} //variadic function
-
 /*** input ***/
 
 char *editorPrompt(char *prompt, void(*callback)(char *, int)){
@@ -933,9 +364,9 @@ char *editorPrompt(char *prompt, void(*callback)(char *, int)){
     
     while(1){
         editorSetStatusMessage(prompt, buf);
-        editorRefreshScreen();
+        if(!editorInputPending(0)) editorRefreshScreen(); //--a pasted answer is drawn once
         
-        int c=editorReadKey();
+        int c=editorReadKey() & ~BATCH_LITERAL; //--typed text is an answer like any other
         if(c==DEL_KEY || c==CTRL_KEY('h') || c==BACKSPACE){
             if(bufflen!=0) buf[--bufflen] = '\0';
         }else if(c=='\x1b'){
@@ -962,6 +393,14 @@ char *editorPrompt(char *prompt, void(*callback)(char *, int)){
     }
 }
 
+void editorOpenPrompt(){
+    char *name = editorPrompt("Open: %s (ESC to cancel)", NULL);
+    if(name==NULL) return;
+    if(editorBufferOpen(name)==-1)
+        editorSetStatusMessage("Can't open %s: %s", name, strerror(errno));
+    free(name);
+}
+
 void editorMoveCursor(int key){
     erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
     
@@ -970,7 +409,7 @@ void editorMoveCursor(int key){
             if(E.cx!=0){
                 E.cx--;
             }else if(E.cy>0){
-                E.cy--;
+                E.cy=editorViewStep(E.cy, -1);
                 E.cx= E.row[E.cy].size;
             }
             break;
@@ -978,17 +417,17 @@ void editorMoveCursor(int key){
             if(row && E.cx < row->size){
                 E.cx++;
             }else if(row && E.cx==row->size){
-                E.cy++;
+                E.cy=editorViewStep(E.cy, 1);
                 E.cx=0;
             }
             break;
         case ARROW_UP:
             if(E.cy!=0){
-                E.cy--;}
+                E.cy=editorViewStep(E.cy, -1);}
             break;
         case ARROW_DOWN:
             if(E.cy<E.numrows){
-                E.cy++;}
+                E.cy=editorViewStep(E.cy, 1);}
             break;
     }
     
@@ -1002,19 +441,40 @@ void editorMoveCursor(int key){
 void editorProcessKeypress() {
     static int quit_times=KILO_QUIT_TIMES;
     int c = editorReadKey();
+    long long t = LATENCY_BEGIN();
+    if(editorHexKey(c)){ //--a binary file, none of the text keys apply
+        LATENCY_END(PROBE_KEYPRESS, t);
+        return;
+    }
+    editorUndoBeginKey();
+    if(c & BATCH_LITERAL){
+        editorInsertChar(c & ~BATCH_LITERAL);
+        LATENCY_END(PROBE_KEYPRESS, t);
+        return;
+    }
 
   switch (c) {
       case '\r':
-          editorInsertNewline();
+          if(E.locations) editorGrepJump();
+          else editorInsertNewline();
           break;
           
       case SHIFT_Q('Q'):
-          if(E.dirty && quit_times>0){
+          if(B.on){
+              B.stop=1;
+              return;
+          }
+          if(S.on){ //--the client goes, the buffers stay with the server
+              S.current->quit=1;
+              return;
+          }
+          if(editorBufferDirty() && quit_times>0){
               editorSetStatusMessage("WARNING! ! ! File has unsaved changes. "
                                      "Press Q %d more times to quit.", quit_times);
               quit_times--;
               return;
           }
+          editorBufferDiscardJournals(); //--a clean quit means the edits are unwanted
           write(STDOUT_FILENO, "\x1b[2J", 4);
           write(STDOUT_FILENO, "\x1b[H", 3);
           exit(0);
@@ -1037,6 +497,75 @@ void editorProcessKeypress() {
           editorFind();
           break;
           
+      case CTRL_KEY('g'):
+          editorGotoLine();
+          break;
+          
+      case CTRL_KEY('t'):
+          editorFollowToggle();
+          break;
+          
+      case CTRL_KEY('z'):
+          editorUndo();
+          break;
+          
+      case CTRL_KEY('y'):
+          editorRedo();
+          break;
+          
+      case CTRL_KEY('p'):
+          editorLatencyToggleOverlay();
+          break;
+          
+      case CTRL_KEY('e'):
+          editorMemReport();
+          break;
+          
+      case CTRL_KEY('o'):
+          editorOpenPrompt();
+          break;
+          
+      case CTRL_KEY('n'):
+          editorBufferNext();
+          editorShowCachedFrame();
+          break;
+          
+      case CTRL_KEY('r'):
+          editorWrapToggle();
+          break;
+          
+      case CTRL_KEY('k'):
+          editorFoldToggle();
+          break;
+          
+      case CTRL_KEY('b'):
+          editorBracketJump();
+          break;
+          
+      case CTRL_KEY('d'):
+          editorDiffToggle();
+          break;
+          
+      case CTRL_KEY('x'):
+          editorLines();
+          break;
+          
+      case CTRL_KEY('a'):
+          editorGrep();
+          break;
+          
+      case CTRL_KEY('w'):
+          if(S.on && editorServerShared()){
+              editorSetStatusMessage("Another client is on this buffer");
+              break;
+          }
+          {
+              int closing=E.current, nbuffers=E.nbuffers;
+              editorBufferClose();
+              if(S.on && E.nbuffers < nbuffers) editorServerClosed(closing);
+          }
+          break;
+          
       case BACKSPACE:
       case CTRL_KEY('h'):
       case DEL_KEY:
@@ -1046,6 +575,10 @@ void editorProcessKeypress() {
           
       case PAGE_UP:
       case PAGE_DOWN:
+        if(editorViewIndexed()){
+            editorViewPage(c==PAGE_UP ? -1 : 1);
+            break;
+        }
         {
             if(c==PAGE_UP){
                 E.cy=E.rowoff;
@@ -1074,40 +607,618 @@ void editorProcessKeypress() {
           editorInsertChar(c);
           break;
   }
+    editorUndoEndKey();
+    LATENCY_END(PROBE_KEYPRESS, t);
 }
 
-/*** init ***/
+/*** batch ***/
+
+/*
+ -->a batch script is one operation per line, replayed on every file:
+        type <text>       the text, inserted as is: F, S, Q and the like
+                          are letters here, not commands
+        key <name> [n]    ENTER ESC TAB BACKSPACE DEL UP DOWN LEFT RIGHT
+                          HOME END PAGE_UP PAGE_DOWN, CTRL-<letter> or a
+                          single character, n times
+        find <text>       F, the text, ENTER
+        goto <line>       CTRL-G, the number, ENTER
+        save | undo | redo | quit
+    blank lines and lines starting with # are skipped
+ */
+typedef struct batchOp{
+    char *line; //--as written, for the trace
+    int *keys;
+    int nkeys;
+}batchOp;
+
+struct batchKeyName{
+    const char *name;
+    int key;
+} batch_keys[]={
+    {"ENTER", '\r'}, {"ESC", '\x1b'}, {"TAB", '\t'}, {"BACKSPACE", BACKSPACE},
+    {"DEL", DEL_KEY}, {"UP", ARROW_UP}, {"DOWN", ARROW_DOWN}, {"LEFT", ARROW_LEFT},
+    {"RIGHT", ARROW_RIGHT}, {"HOME", HOME_KEY}, {"END", END_KEY},
+    {"PAGE_UP", PAGE_UP}, {"PAGE_DOWN", PAGE_DOWN}, {NULL, 0}
+};
+
+int editorBatchKey(){
+    if(B.pos < B.nkeys) return B.keys[B.pos++];
+    return '\x1b'; //--a prompt that ran out of keys is cancelled
+}
 
-void initEditor(){
-    E.cx=0;
-    E.cy=0;
-    E.rx=0;
-    E.rowoff=0;
-    E.coloff=0;
-    E.numrows=0;
-    E.row=NULL;
-    E.dirty = 0;
-    E.filename=NULL;
-    E.statusmsg[0]='\0';
-    E.statusmsg_time=0;
-    E.syntax=NULL;
+void batchPush(batchOp *op, int key){
+    op->keys = realloc(op->keys, sizeof(int)*(op->nkeys+1));
+    op->keys[op->nkeys++] = key;
+}
+
+void batchPushText(batchOp *op, const char *s){
+    while(*s) batchPush(op, (unsigned char)*s++);
+}
+
+void batchPushLiteral(batchOp *op, const char *s){ //--keys no command is bound to
+    while(*s) batchPush(op, BATCH_LITERAL | (unsigned char)*s++);
+}
+
+int batchKeyByName(const char *name){
+    for(int j=0; batch_keys[j].name; j++)
+        if(!strcmp(batch_keys[j].name, name)) return batch_keys[j].key;
+    if(!strncmp(name, "CTRL-", 5) && name[5] && !name[6]) return CTRL_KEY(name[5]);
+    if(name[0] && !name[1]) return (unsigned char)name[0];
+    return -1;
+}
+
+/*
+ -->returns 0 and fills op, 1 for a line without an operation, -1 for a
+    line that makes no sense
+ */
+int batchParseLine(char *line, batchOp *op){
+    int len=strlen(line);
+    while(len>0 && (line[len-1]=='\n' || line[len-1]=='\r')) line[--len]='\0';
+    if(len==0 || line[0]=='#') return 1;
     
-    if(getWindowSize(&E.screenrows, &E.screencols)==-1) die("getWindowSize");
-    E.screenrows-=2;
+    op->line=strdup(line);
+    op->keys=NULL;
+    op->nkeys=0;
+    char *arg=strchr(line, ' ');
+    if(arg) *arg++='\0';
+    else arg="";
+    
+    if(!strcmp(line, "type")){
+        batchPushLiteral(op, arg);
+    }else if(!strcmp(line, "key")){
+        char name[32];
+        int times=1;
+        if(sscanf(arg, "%31s %d", name, &times) < 1) return -1;
+        int key=batchKeyByName(name);
+        if(key==-1) return -1;
+        while(times-- > 0) batchPush(op, key);
+    }else if(!strcmp(line, "find")){
+        batchPush(op, FIND_KEY);
+        batchPushText(op, arg);
+        batchPush(op, '\r');
+    }else if(!strcmp(line, "goto")){
+        batchPush(op, CTRL_KEY('g'));
+        batchPushText(op, arg);
+        batchPush(op, '\r');
+    }else if(!strcmp(line, "save")){
+        batchPush(op, SAVE_KEY);
+    }else if(!strcmp(line, "undo")){
+        batchPush(op, CTRL_KEY('z'));
+    }else if(!strcmp(line, "redo")){
+        batchPush(op, CTRL_KEY('y'));
+    }else if(!strcmp(line, "quit")){
+        batchPush(op, SHIFT_Q('Q'));
+    }else{
+        return -1;
+    }
+    return 0;
 }
 
-int main(int argc, char *argv[]) {
+long long batchNs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+void batchJsonString(FILE *fp, const char *s){ //--quoted, with what JSON can't hold as is escaped
+    fputc('"', fp);
+    for(; *s; s++){
+        unsigned char c=*s;
+        if(c=='"' || c=='\\') fprintf(fp, "\\%c", c);
+        else if(c<0x20) fprintf(fp, "\\u%04x", c);
+        else fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+/*
+ -->replays the script on every file through editorProcessKeypress, with no
+    terminal and no rendering. Each operation is one undo step. With a
+    trace file, every operation leaves a JSON line with its latency. A file
+    that can't be opened, or that has a journal of unsaved edits, is
+    reported and skipped, the exit status is 1 then.
+ */
+int editorBatch(char *script, char *trace, int nfiles, char **files){
+    FILE *fp=fopen(script, "r");
+    if(!fp) die(script);
+    
+    batchOp *ops=NULL;
+    int nops=0;
+    char *line=NULL;
+    size_t linecap=0;
+    int lineno=0;
+    while(getline(&line, &linecap, fp) != -1){
+        lineno++;
+        ops=realloc(ops, sizeof(batchOp)*(nops+1));
+        int r=batchParseLine(line, &ops[nops]);
+        if(r==-1){
+            fprintf(stderr, "%s:%d: can't understand '%s'\n", script, lineno, ops[nops].line);
+            return 1;
+        }
+        if(r==0) nops++;
+    }
+    free(line);
+    fclose(fp);
+    
+    FILE *tf=NULL;
+    if(trace && (tf=fopen(trace, "w"))==NULL) die(trace);
+    
+    B.on=1;
+    E.undo.manual=1;
+    int failed=0;
+    for(int f=0; f<nfiles; f++){
+        struct stat st;
+        const char *why=NULL;
+        if(access(files[f], R_OK)==-1 || stat(files[f], &st)==-1) why=strerror(errno);
+        else if(S_ISDIR(st.st_mode)) why=strerror(EISDIR);
+        else{ //--editorOpen would replay it and the end of the run delete it
+            char *journal=editorJournalPath(files[f]);
+            if(access(journal, F_OK)!=-1) why="has unsaved edits in "KILO_JOURNAL_SUFFIX", recover them in kilo first";
+            free(journal);
+        }
+        if(why){
+            fprintf(stderr, "%s: skipped: %s\n", files[f], why);
+            if(tf){
+                fprintf(tf, "{\"file\": ");
+                batchJsonString(tf, files[f]);
+                fprintf(tf, ", \"error\": ");
+                batchJsonString(tf, why);
+                fprintf(tf, "}\n");
+            }
+            failed=1;
+            continue;
+        }
+        editorOpen(files[f]);
+        B.stop=0;
+        for(int k=0; k<nops && !B.stop; k++){
+            B.keys=ops[k].keys;
+            B.nkeys=ops[k].nkeys;
+            B.pos=0;
+            editorUndoBreak();
+            long long t=batchNs();
+            while(B.pos < B.nkeys && !B.stop) editorProcessKeypress();
+            t=batchNs()-t;
+            if(tf){
+                fprintf(tf, "{\"file\": ");
+                batchJsonString(tf, files[f]);
+                fprintf(tf, ", \"op\": %d, \"keys\": %d, \"ns\": %lld, \"rows\": %d}\n",
+                        k, ops[k].nkeys, t, E.numrows);
+            }
+        }
+        fprintf(stderr, "%s: %d lines, %s\n", files[f], E.numrows,
+                E.dirty ? "modified but not saved" : "clean");
+        editorJournalDiscard(); //--what the script did not save is dropped, the journal is its own
+        editorCloseFile();
+    }
+    if(tf) fclose(tf);
+    return failed;
+}
+
+/*** server ***/
+
+/*
+ -->kilo -s socket: the buffers and their highlighting live in this process
+    only, and every client connected to the socket gets its own cursor,
+    viewport and buffer on them. Wrap and folds are the buffer's, they are
+    shared by every client on it. Keys come in as remoteMsg, screen updates go
+    out as the escape sequences of the lines that changed.
+    While a client is in a prompt (find, goto, open) the server goes on
+    with the others: the prompt's wait runs rounds of the poll loop, a round
+    inside it only queues the keys of clients waiting further down.
+ */
+int editorWriteAll(int fd, const char *s, int len){
+    while(len>0){
+        ssize_t n = write(fd, s, len);
+        if(n==-1){
+            if(errno==EINTR) continue;
+            return -1;
+        }
+        s+=n;
+        len-=n;
+    }
+    return 0;
+}
+
+void editorServerSwapIn(editorClient *c){
+    if(E.nbuffers && c->buffer != E.current){
+        if(c->buffer >= E.nbuffers) c->buffer = E.nbuffers-1;
+        editorBufferSwap(c->buffer);
+    }
+    E.cx=c->cx; E.cy=c->cy; E.rx=c->rx;
+    E.rowoff=c->rowoff; E.coloff=c->coloff;
+    E.view.segoff=c->segoff;
+    E.screenrows=c->screenrows;
+    E.screencols=c->screencols;
+    memcpy(E.statusmsg, c->statusmsg, sizeof(E.statusmsg));
+    E.statusmsg_time=c->statusmsg_time;
+    //--someone else may have cut the rows under the cursor
+    if(E.cy > E.numrows) E.cy = E.numrows;
+    if(E.cy < E.numrows && E.cx > E.row[E.cy].size) E.cx = E.row[E.cy].size;
+    if(E.cy == E.numrows) E.cx = 0;
+    S.current=c;
+}
+
+void editorServerSwapOut(editorClient *c){
+    c->buffer=E.current;
+    c->cx=E.cx; c->cy=E.cy; c->rx=E.rx;
+    c->rowoff=E.rowoff; c->coloff=E.coloff;
+    c->segoff=E.view.segoff;
+    memcpy(c->statusmsg, E.statusmsg, sizeof(E.statusmsg));
+    c->statusmsg_time=E.statusmsg_time;
+}
+
+int editorServerShared(){
+    for(int k=0; k<S.nclients; k++)
+        if(S.clients[k] != S.current && S.clients[k]->buffer == E.current) return 1;
+    return 0;
+}
+
+void editorServerPushKey(editorClient *c, int key){
+    if(c->nkeys == c->capkeys){
+        c->capkeys = c->capkeys ? c->capkeys*2 : 64;
+        c->keys = realloc(c->keys, sizeof(int)*c->capkeys);
+    }
+    c->keys[c->nkeys++]=key;
+}
+
+/*
+ -->takes whatever the client sent and acts on every whole message in it;
+    returns 0 once the client is gone
+ */
+int editorServerRead(editorClient *c){
+    ssize_t n = read(c->fd, c->in+c->inlen, sizeof(c->in)-c->inlen);
+    if(n==-1 && errno==EINTR) return 1;
+    if(n<=0) return 0;
+    c->inlen+=n;
+    
+    int off=0;
+    while(c->inlen-off >= (int)sizeof(remoteMsg)){
+        remoteMsg m;
+        memcpy(&m, c->in+off, sizeof(m));
+        if(m.type=='O' && (m.a<0 || m.a>=PATH_MAX)) return 0;
+        if(m.type=='O' && c->inlen-off < (int)sizeof(m)+m.a) break;
+        off+=sizeof(m);
+        
+        if(m.type=='K'){
+            editorServerPushKey(c, m.a);
+        }else if(m.type=='W'){
+            c->screenrows = m.a>1 ? m.a : 1;
+            c->screencols = m.b>1 ? m.b : 1;
+        }else if(m.type=='O'){
+            char path[PATH_MAX];
+            memcpy(path, c->in+off, m.a);
+            path[m.a]='\0';
+            off+=m.a;
+            editorClient *was=S.current;
+            editorServerSwapIn(c);
+            if(editorBufferOpen(path)==-1)
+                editorSetStatusMessage("Can't open %s: %s", path, strerror(errno));
+            editorServerSwapOut(c);
+            if(was && was!=c) editorServerSwapIn(was);
+        }
+    }
+    memmove(c->in, c->in+off, c->inlen-off);
+    c->inlen-=off;
+    return 1;
+}
+
+/*
+ -->editorReadKey of the server: the next key of the client in E. When a
+    prompt wants more than it has sent, the other clients are served while
+    it waits; its view is put away for that and brought back after.
+ */
+int editorServerKey(){
+    editorClient *c=S.current;
+    while(c->pos >= c->nkeys){
+        if(c->quit || server_stop) return '\x1b'; //--cancels the prompt
+        c->pos=c->nkeys=0;
+        editorRefreshScreen();
+        editorServerSwapOut(c);
+        c->waiting=1;
+        S.depth++;
+        editorServerRound();
+        S.depth--;
+        c->waiting=0;
+        editorServerSwapIn(c);
+    }
+    return c->keys[c->pos++];
+}
+
+void editorServerFrame(editorClient *c){
+    struct abuf ab = ABUF_INIT;
+    editorDrawFrameDiff(&ab, &c->lines, &c->nlines);
+    if(editorWriteAll(c->fd, ab.b, ab.len)==-1) c->quit=1;
+    abFree(&ab);
+}
+
+void editorServerFrames(){
+    for(int k=0; k<S.nclients; k++){
+        editorServerSwapIn(S.clients[k]);
+        editorServerFrame(S.clients[k]);
+        editorServerSwapOut(S.clients[k]);
+    }
+}
+
+/*
+ -->every buffer, not only the ones on screen, gets its journal written and
+    its followed file read
+ */
+int editorServerIdle(){
+    int changed=0;
+    if(E.nbuffers==0){
+        editorJournalSync();
+        return editorFollowPoll();
+    }
+    int current=E.current;
+    for(int k=0; k<E.nbuffers; k++){
+        editorBufferSwap(k);
+        editorJournalSync();
+        if(editorFollowPoll()) changed=1;
+    }
+    editorBufferSwap(current);
+    return changed;
+}
+
+void editorServerAccept(){
+    int fd = accept(S.fd, NULL, NULL);
+    if(fd==-1) return;
+    S.clients = realloc(S.clients, sizeof(editorClient *)*(S.nclients+1));
+    editorClient *c = calloc(1, sizeof(editorClient));
+    S.clients[S.nclients++] = c;
+    c->fd=fd;
+    c->buffer=E.current;
+    c->screenrows=24-2;
+    c->screencols=80;
+    snprintf(c->statusmsg, sizeof(c->statusmsg),
+             "HELP: S = save | Q = detach | CTRL-N/O = next/open buffer");
+    c->statusmsg_time=time(NULL);
+}
+
+void editorServerDrop(int k){
+    editorClient *c=S.clients[k];
+    close(c->fd);
+    editorDrawFrameForget(&c->lines, &c->nlines);
+    free(c->keys);
+    free(c);
+    memmove(&S.clients[k], &S.clients[k+1], sizeof(editorClient *)*(S.nclients-k-1));
+    S.nclients--;
+}
+
+/*
+ -->buffer closing was closed by the client in E: the others that pointed
+    past it move down with the buffers
+ */
+void editorServerClosed(int closing){
+    for(int k=0; k<S.nclients; k++)
+        if(S.clients[k]!=S.current && S.clients[k]->buffer > closing) S.clients[k]->buffer--;
+}
+
+/*
+ -->the keys of one client, one at a time
+ */
+void editorServerKeys(editorClient *c){
+    editorServerSwapIn(c);
+    while(c->pos < c->nkeys && !c->quit) editorProcessKeypress();
+    c->pos=c->nkeys=0;
+    editorJournalSync();
+    editorServerSwapOut(c);
+}
+
+/*
+ -->one turn of the poll loop: new clients are accepted, the ones that sent
+    something get their keys handled, then every screen is brought up to
+    date. Clients waiting in a prompt only get their keys queued, the prompt
+    takes them once the round is over.
+ */
+void editorServerRound(){
+    int nclients=S.nclients;
+    struct pollfd *pfd = malloc(sizeof(struct pollfd)*(nclients+1));
+    editorClient **polled = malloc(sizeof(editorClient *)*(nclients+1)); //--the round may add clients
+    pfd[0].fd=S.fd;
+    pfd[0].events=POLLIN;
+    for(int k=0; k<nclients; k++){
+        polled[k]=S.clients[k];
+        pfd[k+1].fd=polled[k]->fd;
+        pfd[k+1].events=POLLIN;
+    }
+    int r = poll(pfd, nclients+1, 100);
+    
+    int redraw = editorServerIdle();
+    if(r>0){
+        for(int k=0; k<nclients; k++){
+            if(!(pfd[k+1].revents & (POLLIN|POLLHUP|POLLERR)) || polled[k]->quit) continue;
+            if(!editorServerRead(polled[k])) polled[k]->quit=1;
+            else if(!polled[k]->waiting) editorServerKeys(polled[k]);
+            redraw=1;
+        }
+        if(pfd[0].revents & POLLIN){
+            editorServerAccept();
+            redraw=1;
+        }
+    }
+    free(pfd);
+    free(polled);
+    if(S.depth==0)
+        for(int k=S.nclients-1; k>=0; k--)
+            if(S.clients[k]->quit) editorServerDrop(k);
+    if(redraw) editorServerFrames(); //--one client's edit may be on another's screen
+}
+
+void editorServerSignal(int sig){
+    (void)sig;
+    server_stop=1;
+}
+
+int editorServer(char *path, int nfiles, char **files){
+    for(int k=0; k<nfiles; k++)
+        if(editorBufferOpen(files[k])==-1) die(files[k]);
+    
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family=AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    S.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(S.fd==-1) die("socket");
+    struct stat st;
+    if(lstat(path, &st)==0){ //--only a socket nobody answers on, left by a killed server, is removed
+        int probe = S_ISSOCK(st.st_mode) ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+        int stale = probe!=-1 && connect(probe, (struct sockaddr *)&addr, sizeof(addr))==-1 && errno==ECONNREFUSED;
+        if(probe!=-1) close(probe);
+        if(!stale){
+            fprintf(stderr, "%s: %s\n", path, S_ISSOCK(st.st_mode) ? "a server is already running there" : "exists and is not a socket");
+            return 1;
+        }
+        unlink(path);
+    }
+    if(bind(S.fd, (struct sockaddr *)&addr, sizeof(addr))==-1) die("bind");
+    if(listen(S.fd, 16)==-1) die("listen");
+    S.path=path;
+    S.on=1;
+    
+    signal(SIGPIPE, SIG_IGN); //--a client that went away shows up as a failed write
+    signal(SIGINT, editorServerSignal);
+    signal(SIGTERM, editorServerSignal);
+    fprintf(stderr, "kilo: serving %d buffers on %s\n", E.nbuffers, path);
+    
+    while(!server_stop) editorServerRound();
+    
+    //--unsaved edits stay in the journals, the next kilo on the file recovers them
+    while(S.nclients) editorServerDrop(S.nclients-1);
+    close(S.fd);
+    unlink(path);
+    for(int k=E.nbuffers-1; k>0; k--){
+        editorBufferSwap(k);
+        editorCloseFile();
+    }
+    if(E.nbuffers) editorBufferSwap(0);
+    editorCloseFile();
+    return 0;
+}
+
+/*** client ***/
+
+int editorClientSend(int fd, int type, int a, int b){
+    remoteMsg m={type, a, b};
+    return editorWriteAll(fd, (char *)&m, sizeof(m));
+}
+
+/*
+ -->kilo -c socket [file]: only the terminal side of the editor, keys go to
+    the server and what it sends back goes to the screen
+ */
+int editorConnect(char *path, char *file){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family=AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path)-1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd==-1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))==-1){
+        perror(path);
+        return 1;
+    }
+    
+    char full[PATH_MAX];
+    if(file && !realpath(file, full)){ //--the server has a working directory of its own
+        perror(file);
+        return 1;
+    }
+    
     enableRawMode();
+    int rows, cols;
+    if(getWindowSize(&rows, &cols)==-1) die("getWindowSize");
+    editorClientSend(fd, 'W', rows-2, cols);
+    if(file){
+        editorClientSend(fd, 'O', strlen(full), 0);
+        editorWriteAll(fd, full, strlen(full));
+    }
+    
+    char buf[64*1024];
+    while(1){
+        struct pollfd pfd[2]={{STDIN_FILENO, POLLIN, 0}, {fd, POLLIN, 0}};
+        if(poll(pfd, 2, -1)==-1){
+            if(errno==EINTR) continue;
+            die("poll");
+        }
+        if(pfd[0].revents & POLLIN){
+            if(editorClientSend(fd, 'K', editorReadKey(), 0)==-1) break;
+        }
+        if(pfd[1].revents & (POLLIN|POLLHUP|POLLERR)){
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if(n<=0) break; //--detached or the server is gone
+            write(STDOUT_FILENO, buf, n);
+        }
+    }
+    write(STDOUT_FILENO, "\x1b[2J", 4);
+    write(STDOUT_FILENO, "\x1b[H", 3);
+    close(fd);
+    return 0;
+}
+
+/*** init ***/
+
+int main(int argc, char *argv[]) {
+    char *script=NULL, *trace=NULL, *profile=NULL, *serve=NULL, *connect_to=NULL;
+    int opt;
     initEditor();
-    if(argc>=2){
-        editorOpen(argv[1]);
+    while((opt=getopt(argc, argv, "b:t:p:m:s:c:")) != -1){
+        switch(opt){
+            case 'b': script=optarg; break;
+            case 't': trace=optarg; break;
+            case 'p': profile=optarg; break;
+            case 'm': E.mem.budget=atoll(optarg)*1024*1024; break;
+            case 's': serve=optarg; break;
+            case 'c': connect_to=optarg; break;
+            default:
+                fprintf(stderr, "usage: kilo [-m budget MB] [-p trace.json] [-b script [-t trace] | -s socket] [file ...]\n"
+                                "       kilo -c socket [file]\n");
+                return 1;
+        }
+    }
+    
+    if(profile){
+        editorLatencyStart(profile);
+        atexit(editorLatencyDump); //--Q and die leave through exit()
     }
+    if(script) return editorBatch(script, trace, argc-optind, &argv[optind]);
+    if(serve) return editorServer(serve, argc-optind, &argv[optind]);
+    if(connect_to) return editorConnect(connect_to, optind<argc ? argv[optind] : NULL);
     
-    editorSetStatusMessage("HELP: S = save | Q = quit | CTRL-F = find");
+    enableRawMode();
+    if(getWindowSize(&E.screenrows, &E.screencols)==-1) die("getWindowSize");
+    E.screenrows-=2; //--status and message bar
+    editorSetStatusMessage("HELP: S = save | Q = quit | CTRL-F = find | CTRL-Z/Y = undo/redo");
+    for(int k=optind; k<argc; k++)
+        if(editorBufferOpen(argv[k])==-1) die(argv[k]); //--may report a journal recovery
+    editorBufferSwitch(0);
     
+    editorRefreshScreen();
     while (1) {
-        editorRefreshScreen();
         editorProcessKeypress();
+        editorScheduleFrame();
     }
     
     return 0;
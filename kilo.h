@@ -8,6 +8,504 @@
 #ifndef kilo_h
 #define kilo_h
 
+/* includes */
+
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <time.h>
 #include <stdio.h>
 
+/*defines*/
+/*
+  --->terminate key == Q !!!!!
+ */
+#define KILO_VERSION "0.0.1"
+#define KILO_TAB_STOP 8
+#define KILO_QUIT_TIMES 3
+#define KILO_JOURNAL_SUFFIX ".kjournal"
+#define KILO_JOURNAL_MAGIC "KJN1"
+#define KILO_JOURNAL_SYNC_MS 250 //--group commit window for fdatasync
+#ifndef KILO_UNDO_LIMIT
+#define KILO_UNDO_LIMIT (64*1024*1024) //--bytes the undo log may hold
+#endif
+#define KILO_UNDO_CHUNK (64*1024) //--arena block size for undo text
+#define KILO_UNDO_GROUP_MS 10 //--keys closer than this (pastes) undo as one
+#define KILO_UNDO_SPLICE 16 //--row records in a run that undo as one splice of the row array
+#define KILO_INDEX_THREADS 16 //--upper bound on line index workers
+#define KILO_INDEX_BLOCK (1024*1024) //--unit of index work
+#define KILO_CACHE_SUFFIX ".kindex"
+#define KILO_CACHE_MAGIC "KIDX0003"
+#define KILO_CACHE_MIN_SIZE (4*1024*1024) //--smaller files are not worth a cache
+#define KILO_CACHE_SAMPLES 16 //--pieces of the file the cache check hashes, the first and last among them
+#define KILO_CACHE_SAMPLE (64*1024) //--bytes per piece
+#define KILO_FOLLOW_READ (256*1024) //--bytes appended per step in follow mode
+#define KILO_LATENCY_SUB_BITS 4 //--16 buckets per power of two, ~6% resolution
+#define KILO_LATENCY_BUCKETS (61<<KILO_LATENCY_SUB_BITS) //--enough for any 64 bit ns value
+#define KILO_TRACE_EVENTS (64*1024) //--the trace keeps the last this many probe events
+#define KILO_BRACKET_BLOCK 64 //--rows per leaf of the bracket index
+#define KILO_DIFF_GUTTER 2 //--columns before the text for the diff marks
+#define KILO_DIFF_COST 4096 //--edits a diff looks for between two matching lines
+#define KILO_LINES_BLOCK (64*1024) //--rows worth a thread of their own in line commands
+#define KILO_GZIP_SUFFIX ".gz"
+#define KILO_GZIP_CHUNK (4*1024*1024) //--inflated bytes handed to the row builder at a time
+#define KILO_GZIP_SLOTS 4 //--chunks the inflating thread may run ahead
+#define KILO_HEX_WIDTH 16 //--bytes per line of the hex view
+#define KILO_HEX_SNIFF 8192 //--bytes looked at to tell a binary file from text
+#define KILO_GREP_LINE 256 //--bytes of a matching line shown in the results
+#define KILO_GREP_DRAW_MS 100 //--how often a running search shows its results so far
+#define KILO_SYNTAX_DIR ".kilo/syntax" //--under $HOME, unless $KILO_SYNTAX names another
+#define KILO_SYNTAX_SUFFIX ".ksyntax"
+#define KILO_SYNTAX_CACHE "syntax.kcache" //--the compiled definitions, in that directory
+#define KILO_SYNTAX_MAGIC "KSYN0001"
+#define KILO_FRAME_MS 16 //--shortest time between two frames that change the text, ~60 Hz
+#define KILO_FRAME_MAX_MS 250 //--longest a frame is held back by a busy terminal or a key burst
+
+#ifdef __APPLE__
+#define fdatasync fsync //--darwin has no fdatasync in its headers
+#endif
+
+#define SHIFT_Q(k) ((k) & 0x51) // end
+#define CTRL_KEY(k) ((k) & 0x1f)
+
+enum editorKey{ // using int type with a high value to avoid confussion with chars
+    FIND_KEY=70,
+    SAVE_KEY=83, //save key
+    BACKSPACE=127,
+    ARROW_RIGHT = 1000,
+    ARROW_LEFT ,
+    ARROW_UP ,
+    ARROW_DOWN,
+    DEL_KEY,
+    HOME_KEY,
+    END_KEY,
+    PAGE_UP,
+    PAGE_DOWN
+};
+
+enum editorHighlight{
+    HL_NORMAL=0,
+    HL_COMMENT,
+    HL_MLCOMMENT,
+    HL_KEYWORD1,
+    HL_KEYWORD2,
+    HL_STRING,
+    HL_NUMBER,
+    HL_MATCH
+};
+
+enum journalOp{ //--one byte tag in front of every journal record
+    JOURNAL_ROW_INSERT=1,
+    JOURNAL_ROW_DEL,
+    JOURNAL_TEXT_INSERT,
+    JOURNAL_TEXT_DEL,
+    JOURNAL_ROW_ORDER //--len rows follow, each an old row number+1 or 0 and its text
+};
+
+enum undoOp{
+    UNDO_TEXT_INSERT,
+    UNDO_TEXT_DEL,
+    UNDO_ROW_INSERT,
+    UNDO_ROW_DEL,
+    UNDO_ROW_ORDER
+};
+
+enum latencyProbe{
+    PROBE_READ_KEY,
+    PROBE_KEYPRESS,
+    PROBE_SYNTAX,
+    PROBE_DRAW_ROWS,
+    PROBE_WRITE,
+    PROBE_COUNT
+};
+
+enum memKind{ //--what the bytes accounted in E.mem are used for
+    MEM_CHARS,
+    MEM_RENDER,
+    MEM_HL,
+    MEM_ROWS, //--the E.row array itself
+    MEM_SEARCH,
+    MEM_OUTPUT,
+    MEM_COUNT
+};
+
+#define HL_HIGHLIGHT_NUMBERS (1<<0)
+#define HL_HIGHLIGHT_STRING (1<<1)
+
+/*data*/
+
+struct editorSyntax{ //--used for highlighting
+    char *filetype;
+    char **filematch;
+    char **keywords; //--sorted by their first byte
+    char *singleline_comment_start;
+    char *multiline_comment_start;
+    char *multiline_comment_end;
+    int flags;
+    const uint16_t *first; //--keywords starting with byte c are [first[c], first[c+1])
+    const unsigned char *quote; //--per byte: opens a string
+    const unsigned char *separator; //--per byte: may come before and after a keyword
+};
+
+struct bracketSum{ //--brackets opened minus closed over a stretch of text
+    int net;
+    int low; //--lowest running count from the start, 0 at most
+    int high; //--highest count of a suffix, 0 at least
+};
+
+typedef struct erow{ //editor row -> storest a line of text as a pointer to the dynamically-allocated character data and length.
+    int idx;
+    int size;
+    int rsize;
+    struct bracketSum brace; //--of ( [ { against ) ] } outside of strings and comments
+    char *chars;
+    char *render;
+    unsigned char *hl;
+    int hl_open_comment;
+    int hidden; //--closed folds it is inside of
+}erow;
+
+struct editorJournal{ //--append-only log of edits made since the last save
+    int fd; //-- -1 while there is nothing to log
+    int suspended; //--set while editorOpen loads the file or replays a journal
+    char *buf; //--records not yet handed to write()
+    int len;
+    int cap;
+    int unsynced; //--written but not fdatasync'ed yet
+    long long last_sync;
+};
+
+typedef struct undoChunk{ //--arena block, freed once no record points into it
+    int used;
+    int cap;
+    int refs;
+    char data[];
+}undoChunk;
+
+/*
+ -->the rows rearranged in one go: sort, unique, filter, and undoing them.
+    Row j of the result is old row src[j], or for src[j]==-1-k a new row
+    with text[k]; old rows nothing refers to go.
+ */
+typedef struct rowOrder{
+    int *src;
+    int n;
+    char **text; //--taken over by the rows
+    int *len;
+    int ntext;
+}rowOrder;
+
+typedef struct undoRecord{
+    unsigned char op;
+    int group; //--undo and redo always take a whole group
+    int row, at, len;
+    char *data; //--text that is currently NOT in the buffer, NULL otherwise
+    undoChunk *chunk; //--arena block of data, NULL if data is a row buffer held by reference
+    int cx, cy; //--cursor before the key that made the edit
+    int acx, acy; //--and after it
+    rowOrder *order; //--UNDO_ROW_ORDER: what puts the rows back as they were
+}undoRecord;
+
+struct editorUndo{
+    undoRecord *rec;
+    int first, pos, n, cap; //--[first,pos) can be undone, [pos,n) redone
+    undoChunk *chunk; //--arena block new text goes into
+    size_t bytes; //--accounted against KILO_UNDO_LIMIT
+    int group;
+    int newgroup; //--the next record starts a group
+    int sealed; //--the top record may not be extended any more
+    int touched; //--the top record was made by the current key
+    int suspended;
+    int manual; //--groups only end at editorUndoBreak, not by key timing
+    int kcx, kcy;
+    long long last_key;
+};
+
+struct editorFollow{ //--tail -F like view of a growing file
+    int on;
+    int fd; //--the file as opened, survives a rename
+    int ifd; //--inotify instance, -1 where there is none
+    int wd;
+    int pending; //--re-check the file on the next tick even without an event
+    dev_t dev;
+    ino_t ino;
+    off_t offset; //--bytes of the file already in the buffer
+    int partial; //--the last row was not terminated by a newline yet
+};
+
+struct latencyHist{ //--HDR style: log buckets split linearly
+    unsigned long long count;
+    unsigned long long max;
+    unsigned counts[KILO_LATENCY_BUCKETS];
+};
+
+struct latencyEvent{
+    long long ts, dur; //--ns since the probes were turned on
+    int probe;
+};
+
+struct editorLatency{
+    int on; //--probes cost a single test while this is 0
+    int overlay; //--percentiles in the status bar instead of the file name
+    long long t0;
+    struct latencyHist hist[PROBE_COUNT];
+    long long frames, frame_bytes, last_frame_bytes;
+    struct latencyEvent *events; //--ring of KILO_TRACE_EVENTS, NULL without a trace file
+    long long nevents;
+    char *trace; //--where editorLatencyDump writes the Chrome trace
+};
+
+struct editorMemory{
+    long long cur[MEM_COUNT]; //--bytes asked of malloc, not what it took for them
+    long long peak[MEM_COUNT];
+    long long budget; //--0 for none; above it off-screen render and hl are dropped
+    int drop_next; //--where the next round of dropping starts
+    long long dropped; //--rows that lost render and hl so far
+};
+
+/*abbend buffer*/
+
+struct abuf{
+    char *b;
+    int len;
+};
+#define ABUF_INIT {NULL, 0}
+
+/*
+ -->a segment tree over the bracket summaries of blocks of rows: the row
+    where a bracket's partner is, however far, is found in O(log n)
+ */
+struct editorBrackets{
+    struct bracketSum *tree; //--node 1 is the root, leaves from cap on
+    int cap; //--leaves, a power of two
+    int valid; //--rows whose blocks are right, the rest is rebuilt when needed
+    int rows; //--rows it was last built for
+    int match; //--the cursor is at a bracket whose partner is at mrow, mrx
+    int mrow, mrx;
+};
+
+enum diffMark{
+    DIFF_SAME=0,
+    DIFF_ADDED,
+    DIFF_CHANGED,
+    DIFF_REMOVED //--lines of the disk file are missing next to this row
+};
+
+struct editorDiff{ //--the rows against the file on disk
+    int on;
+    int stale; //--edited since the marks were made
+    int touched; //--edited since the file was read or written, but only
+    int first, after; //--from row first on and not in the last after rows
+    unsigned long long dev, ino; //--the file as it was then
+    long long size, mtime;
+    unsigned char *marks; //--a diffMark per row
+    int nmarks;
+    uint64_t *hash; //--of every row, 0 until it is hashed
+    int *line; //--of every row, the disk line it matched, -1 for none
+    int nhash, caphash;
+    uint64_t *lines; //--line hashes of the file on disk, as it is now
+    int nlines;
+    unsigned long long lines_ino;
+    long long lines_size, lines_mtime;
+    int added, changed, removed;
+    long long ms; //--the last diff took
+};
+
+struct editorHex{ //--read only view of a binary file, straight from its mapping
+    int on;
+    const unsigned char *map;
+    size_t size;
+    size_t top; //--offset of the first byte on screen, a multiple of KILO_HEX_WIDTH
+    size_t cur; //--offset of the byte under the cursor
+};
+
+struct editorFold{ //--a closed fold: start stays on screen, start+1..end don't
+    int start, end;
+};
+
+struct editorView{ //--maps display lines to rows when they are not the same
+    int wrap; //--soft wrap at the screen width instead of horizontal scrolling
+    int width; //--columns the index was built for, 0 without wrap
+    int *tree; //--Fenwick tree of display lines per row, 1-based; hidden rows have none
+    int n; //--rows it has room for
+    int valid; //--rows whose entries are right, the rest is rebuilt when needed
+    int segoff; //--display line within E.rowoff the screen starts at
+    struct editorFold *folds; //--sorted by start
+    int nfolds, capfolds;
+};
+
+typedef struct editorBuffer{ //--an open file while another one is on screen
+    int cx, cy, rx;
+    int rowoff, coloff;
+    int numrows;
+    erow *row;
+    long long rowbytes;
+    int dirty;
+    char *filename;
+    int gzip;
+    struct editorSyntax *syntax;
+    struct editorJournal journal;
+    struct editorUndo undo;
+    struct editorFollow follow;
+    struct editorView view;
+    struct editorBrackets brackets;
+    struct editorDiff diff;
+    struct editorHex hex;
+    int locations;
+    struct abuf frame; //--its screen when it was left, shown at once on return
+    long long used; //--when it was last on screen, the oldest loses render and hl first
+    int derived; //--some of its rows may still have render and hl
+}editorBuffer;
+
+struct editorConfig{ //--global editor struct
+    int cx, cy; //coordonates for x and y on the terminal
+    int rx; //coordonate for showing TABS/etc
+    int rowoff; //vertical scrolling
+    int coloff; //horizontal scrolling
+    int screenrows;
+    int screencols;
+    int numrows;
+    erow *row;
+    long long rowbytes; //--size of the E.row block, for E.mem
+    int dirty;
+    char *filename;
+    int gzip; //--the file is gzip compressed, saves compress it again
+    char statusmsg[160];
+    time_t statusmsg_time;
+    struct editorSyntax *syntax;
+    struct editorJournal journal;
+    struct editorUndo undo;
+    struct editorFollow follow;
+    struct editorView view;
+    struct editorBrackets brackets;
+    struct editorDiff diff;
+    struct editorHex hex;
+    int locations; //--rows are file:line: results, ENTER opens the one under the cursor
+    struct editorLatency latency;
+    struct editorMemory mem;
+    editorBuffer *buffers; //--every open file; the one at current lives in the fields above
+    int nbuffers;
+    int current;
+};
+extern struct editorConfig E;
+
+//--probes around the hot paths, t is 0 when they were off at the start
+#define LATENCY_BEGIN() (E.latency.on ? editorLatencyNow() : 0)
+#define LATENCY_END(probe, t) do{ if(t) editorLatencyAdd((probe), (t)); }while(0)
+
+/*prototypes*/
+
+//--the editor core (kilo_core.c), free of any terminal i/o
+void initEditor();
+long long editorMonotonicMs();
+uint64_t editorHashBlock(const char *p, size_t len);
+void editorUpdateRender(erow *row);
+void editorUpdateRow(erow *row);
+void editorInsertRow(int at, char *s, size_t len);
+void editorFreeRow(erow *row);
+void editorDelRow(int at);
+void editorInsertChar(int c);
+void editorInsertNewline();
+void editorDelChar();
+void editorUndoRecord(int op, int row, int at, const char *s, int len);
+void editorUndoRowDel(erow *row);
+void editorUndoBeginKey();
+void editorUndoEndKey();
+void editorUndoBreak();
+void editorUndo();
+void editorRedo();
+void editorUndoClear();
+char *editorJournalPath(const char *filename);
+void editorJournalSync();
+void editorJournalDiscard();
+void editorOpen(char *filename);
+void editorSave();
+void editorCloseFile();
+int editorBufferOpen(char *filename);
+void editorBufferNew();
+void editorBufferSwap(int n);
+void editorBufferSwitch(int n);
+void editorBufferNext();
+void editorBufferClose();
+int editorBufferDirty();
+void editorBufferDiscardJournals();
+int editorFollowPoll();
+void editorFollowToggle();
+void editorFollowStop();
+void editorFindCallback(char *query, int key);
+void editorFind();
+void editorGotoLine();
+int editorWrapSegs(int rsize);
+void editorWrapToggle();
+void editorViewPage(int dir);
+int editorViewIndexed();
+int editorViewStep(int cy, int dir);
+void editorFoldToggle();
+int editorBracketDelta(erow *row, int i);
+void editorBracketUpdate(int at);
+void editorBracketInvalidate(int at);
+int editorBracketForward(int row, int *depth);
+int editorBracketBackward(int row, int *need);
+void editorBracketUpdateMatch();
+void editorBracketJump();
+void editorRowOrderFree(rowOrder *o);
+long long editorRowOrderBytes(rowOrder *o);
+void editorRowsApply(rowOrder *o, rowOrder *undo);
+void editorLinesSort();
+void editorLinesUnique();
+void editorLinesFilter(const char *text, int keep);
+void editorLinesCommand(char *cmd);
+void editorLines();
+void editorDiffReset();
+void editorDiffTouch(int at, int after);
+void editorDiffRowInserted(int at);
+void editorDiffRowDeleted(int at);
+void editorDiffRowChanged(int at);
+void editorDiffUpdate();
+void editorDiffToggle();
+void editorDiffFree();
+int editorTextCols();
+int editorHexDetect(const char *map, size_t size);
+void editorHexOpen(const char *map, size_t size);
+void editorHexClose();
+int editorHexKey(int c);
+void editorHexCursor(int *y, int *x);
+void editorGrep();
+void editorGrepJump();
+void editorFoldReveal(int at);
+void editorFoldRowInserted(int at);
+void editorFoldRowDeleted(int at);
+int editorFoldAt(int at);
+void editorViewUpdate(int at, int delta);
+void editorViewInvalidate(int at);
+void editorViewScroll();
+int editorViewPrefix(int rows);
+int editorViewFind(int line, int *seg);
+void editorCursorOnScreen(int *y, int *x);
+void editorScroll();
+void editorMemAdd(int kind, long long delta);
+void editorMemReport();
+long long editorLatencyNow();
+void editorLatencyAdd(int probe, long long start);
+void editorLatencyFrame(long long bytes);
+void editorLatencyStart(char *trace);
+void editorLatencyToggleOverlay();
+void editorLatencyDump();
+void abAppend(struct abuf *ab, const char *s, int len);
+void abFree(struct abuf *ab);
+void editorDrawFrame(struct abuf *ab);
+void editorDrawFrameDiff(struct abuf *ab, struct abuf **lines, int *nlines);
+void editorDrawFrameForget(struct abuf **lines, int *nlines);
+void editorDrawFrameLines(struct abuf *ab, const char *text, int len, struct abuf **lines, int *nlines);
+void editorDrawFrameSeed(const struct abuf *frame, struct abuf **lines, int *nlines);
+void editorSetStatusMessage(const char *fmt, ...);
+
+//--provided by the front end (kilo.c for the terminal)
+void die(const char *s);
+char *editorPrompt(char *prompt, void (*callback)(char*, int));
+int editorProgress(); //--shows a long job's partial results, 1 if the user stopped it
+
 #endif /* kilo_h */
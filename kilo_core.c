@@ -0,0 +1,5217 @@
+//
+//  kilo_core.c
+//  Text Editor
+//
+//  Created by Simionescu Teodor on 29.07.2022.
+//
+
+/* includes */
+
+#include "kilo.h"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include <errno.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <zlib.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/*data*/
+
+struct editorConfig E;
+
+/* filetypes */
+
+/*
+ -->the languages kilo knows without any definition files, written the way
+    those files are (see editorSyntaxParse)
+ */
+const char *kilo_builtin_syntax =
+    "filetype c\n"
+    "match .c .cpp .h\n"
+    "keywords switch if while for break continue return else\n"
+    "keywords struct union typedef static enum class case\n"
+    "types int long double float char unsigned signed void\n"
+    "comment //\n"
+    "multiline /* */\n"
+    "strings \"'\n"
+    "numbers\n";
+
+#define SYNTAX_NONE UINT32_MAX
+
+/*
+ -->the compiled definitions are one block, the same in memory and in the
+    cache file: this header, the string table (pool offsets of the keywords
+    and filename matches, a range per definition), the records, the
+    extension hash table as (pool offset, record) pairs, then the pool
+ */
+struct syntaxHeader{
+    char magic[8];
+    uint64_t stamp; //--of the definitions it was compiled from
+    uint32_t nstr, nrec, nhash, pool;
+};
+
+struct syntaxRecord{
+    uint32_t filetype, scs, mcs, mce; //--pool offsets, SYNTAX_NONE if not given
+    uint32_t flags;
+    uint32_t keywords, nkeywords; //--in the string table, sorted by first byte
+    uint32_t matches, nmatches;
+    uint16_t first[257];
+    unsigned char quote[256];
+    unsigned char separator[256];
+};
+
+struct syntaxBuild{ //--definitions as they are parsed, before they are laid out
+    struct abuf pool;
+    uint32_t *str;
+    int nstr, capstr;
+    struct syntaxRecord *rec;
+    int nrec;
+    int open; //--rec[nrec-1] is still being read
+    uint32_t *kw, *match; //--of the open definition
+    int nkw, nmatch, capkw, capmatch;
+};
+
+struct syntaxDb{
+    char *blob;
+    const struct syntaxHeader *h;
+    const uint32_t *hash;
+    const char *pool;
+    struct editorSyntax *syntax;
+    char **lists; //--the NULL terminated keywords and filematch of every syntax
+    int n;
+    int ready;
+}syntax_db;
+
+int is_separator(int c){
+    return isspace(c) || c=='\0' || strchr(",.()+-/*=~%<>[];", c) !=NULL;
+}
+
+uint32_t editorSyntaxString(struct syntaxBuild *b, const char *s, size_t len, int kw2){
+    uint32_t off=b->pool.len;
+    abAppend(&b->pool, s, len);
+    if(kw2) abAppend(&b->pool, "|", 1); //--the highlighter's mark of the second keyword class
+    abAppend(&b->pool, "", 1);
+    return off;
+}
+
+void editorSyntaxList(uint32_t **list, int *n, int *cap, uint32_t off){
+    if(*n==*cap){
+        *cap = *cap ? *cap*2 : 32;
+        *list = realloc(*list, sizeof(uint32_t)*(*cap));
+    }
+    (*list)[(*n)++]=off;
+}
+
+/*
+ -->closes the open definition: its keywords are sorted by first byte
+    (stable, so the order they were written in still counts within one),
+    then they and its filename matches go into the string table
+ */
+void editorSyntaxEnd(struct syntaxBuild *b){
+    if(!b->open) return;
+    b->open=0;
+    struct syntaxRecord *r=&b->rec[b->nrec-1];
+    const char *pool=b->pool.b;
+    for(int i=1; i<b->nkw; i++){
+        uint32_t k=b->kw[i];
+        int j=i;
+        for(; j>0 && (unsigned char)pool[b->kw[j-1]] > (unsigned char)pool[k]; j--)
+            b->kw[j]=b->kw[j-1];
+        b->kw[j]=k;
+    }
+    r->keywords=b->nstr;
+    r->nkeywords=b->nkw;
+    int j=0;
+    for(int c=0; c<256; c++){
+        while(j<b->nkw && (unsigned char)pool[b->kw[j]] < c) j++;
+        r->first[c]=j;
+    }
+    r->first[256]=b->nkw;
+    for(int i=0; i<b->nkw; i++) editorSyntaxList(&b->str, &b->nstr, &b->capstr, b->kw[i]);
+    r->matches=b->nstr;
+    r->nmatches=b->nmatch;
+    for(int i=0; i<b->nmatch; i++) editorSyntaxList(&b->str, &b->nstr, &b->capstr, b->match[i]);
+    b->nkw=b->nmatch=0;
+}
+
+/*
+ -->reads definitions, one directive a line:
+        filetype NAME            starts a definition
+        match .EXT NAME ...      extensions, or text anywhere in the file name
+        keywords WORD ...        highlighted as keywords
+        types WORD ...           highlighted as the second kind of keyword
+        comment START            single line comments
+        multiline START END      comment blocks
+        strings CHARS            the quotes that open (and close) strings
+        numbers                  highlight numbers
+        separators CHARS         what may surround a keyword besides white
+                                 space, by default the operators and
+                                 punctuation of C
+    blank lines and lines starting with # are skipped
+ */
+void editorSyntaxParse(struct syntaxBuild *b, const char *text, size_t len, const char *name){
+    int lineno=0;
+    const char *p=text, *end=text+len;
+    while(p<end){
+        const char *eol=memchr(p, '\n', end-p);
+        if(!eol) eol=end;
+        const char *line=p, *le=eol;
+        p=eol+1;
+        lineno++;
+        while(le>line && (le[-1]=='\r' || le[-1]==' ' || le[-1]=='\t')) le--;
+        while(line<le && (*line==' ' || *line=='\t')) line++;
+        if(line==le || *line=='#') continue;
+        
+        const char *w=line;
+        while(w<le && *w!=' ' && *w!='\t') w++;
+        size_t dlen=w-line;
+        while(w<le && (*w==' ' || *w=='\t')) w++; //--w..le is the argument
+        #define DIRECTIVE(d) (dlen==strlen(d) && !strncmp(line, d, dlen))
+        
+        if(DIRECTIVE("filetype") && w<le){
+            editorSyntaxEnd(b);
+            b->rec=realloc(b->rec, sizeof(struct syntaxRecord)*(b->nrec+1));
+            struct syntaxRecord *r=&b->rec[b->nrec++];
+            memset(r, 0, sizeof(*r));
+            r->filetype=editorSyntaxString(b, w, le-w, 0);
+            r->scs=r->mcs=r->mce=SYNTAX_NONE;
+            for(int c=0; c<256; c++) r->separator[c]=is_separator(c);
+            b->open=1;
+            continue;
+        }
+        if(!b->open){
+            editorSetStatusMessage("%s:%d: no filetype line before this", name, lineno);
+            continue;
+        }
+        struct syntaxRecord *r=&b->rec[b->nrec-1];
+        if(DIRECTIVE("match") || DIRECTIVE("keywords") || DIRECTIVE("types")){
+            int match=DIRECTIVE("match");
+            while(w<le){
+                const char *e=w;
+                while(e<le && *e!=' ' && *e!='\t') e++;
+                uint32_t off=editorSyntaxString(b, w, e-w, DIRECTIVE("types"));
+                if(match) editorSyntaxList(&b->match, &b->nmatch, &b->capmatch, off);
+                else if(b->nkw < UINT16_MAX) editorSyntaxList(&b->kw, &b->nkw, &b->capkw, off);
+                w=e;
+                while(w<le && (*w==' ' || *w=='\t')) w++;
+            }
+        }else if(DIRECTIVE("comment") && w<le){
+            r->scs=editorSyntaxString(b, w, le-w, 0);
+        }else if(DIRECTIVE("multiline") && w<le){
+            const char *e=w;
+            while(e<le && *e!=' ' && *e!='\t') e++;
+            const char *w2=e;
+            while(w2<le && (*w2==' ' || *w2=='\t')) w2++;
+            if(w2==le){
+                editorSetStatusMessage("%s:%d: multiline needs a start and an end", name, lineno);
+                continue;
+            }
+            r->mcs=editorSyntaxString(b, w, e-w, 0);
+            r->mce=editorSyntaxString(b, w2, le-w2, 0);
+        }else if(DIRECTIVE("strings")){
+            for(; w<le; w++) r->quote[(unsigned char)*w]=1;
+            r->flags|=HL_HIGHLIGHT_STRING;
+        }else if(DIRECTIVE("numbers")){
+            r->flags|=HL_HIGHLIGHT_NUMBERS;
+        }else if(DIRECTIVE("separators")){
+            for(int c=0; c<256; c++) r->separator[c] = isspace(c) || c=='\0';
+            for(; w<le; w++) r->separator[(unsigned char)*w]=1;
+        }else{
+            editorSetStatusMessage("%s:%d: unknown directive %.*s", name, lineno, (int)dlen, line);
+        }
+        #undef DIRECTIVE
+    }
+    editorSyntaxEnd(b); //--a definition doesn't go on into the next file
+}
+
+/*
+ -->lays the parsed definitions out as one block; extensions defined later
+    (in files, over the built-in ones) win
+ */
+char *editorSyntaxLayout(struct syntaxBuild *b, uint64_t stamp, size_t *len){
+    uint32_t nhash=16;
+    while(nhash < 2*(uint32_t)(b->nstr+1)) nhash*=2;
+    uint32_t *hash=malloc(sizeof(uint32_t)*2*nhash);
+    for(uint32_t i=0; i<2*nhash; i++) hash[i]=SYNTAX_NONE;
+    for(int k=0; k<b->nrec; k++){
+        struct syntaxRecord *r=&b->rec[k];
+        for(uint32_t m=r->matches; m<r->matches+r->nmatches; m++){
+            const char *ext=b->pool.b+b->str[m];
+            if(ext[0]!='.') continue;
+            uint32_t slot=editorHashBlock(ext, strlen(ext)) & (nhash-1);
+            while(hash[2*slot]!=SYNTAX_NONE && strcmp(b->pool.b+hash[2*slot], ext))
+                slot=(slot+1) & (nhash-1);
+            hash[2*slot]=b->str[m];
+            hash[2*slot+1]=k;
+        }
+    }
+    
+    struct syntaxHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, KILO_SYNTAX_MAGIC, 8);
+    h.stamp=stamp;
+    h.nstr=b->nstr;
+    h.nrec=b->nrec;
+    h.nhash=nhash;
+    h.pool=b->pool.len;
+    *len = sizeof(h) + sizeof(uint32_t)*h.nstr + sizeof(struct syntaxRecord)*h.nrec +
+           sizeof(uint32_t)*2*h.nhash + h.pool;
+    char *blob=malloc(*len), *p=blob;
+    memcpy(p, &h, sizeof(h));
+    p+=sizeof(h);
+    memcpy(p, b->str, sizeof(uint32_t)*h.nstr);
+    p+=sizeof(uint32_t)*h.nstr;
+    memcpy(p, b->rec, sizeof(struct syntaxRecord)*h.nrec);
+    p+=sizeof(struct syntaxRecord)*h.nrec;
+    memcpy(p, hash, sizeof(uint32_t)*2*h.nhash);
+    p+=sizeof(uint32_t)*2*h.nhash;
+    memcpy(p, b->pool.b, h.pool);
+    free(hash);
+    return blob;
+}
+
+/*
+ -->makes the block the syntax database, after checking that nothing in it
+    points outside of it (a cache file could be anything). Takes blob over
+    and returns 0, or -1 leaving it to the caller.
+ */
+int editorSyntaxUse(char *blob, size_t len){
+    const struct syntaxHeader *h=(const struct syntaxHeader *)blob;
+    if(len < sizeof(*h) || memcmp(h->magic, KILO_SYNTAX_MAGIC, 8) ||
+       h->nhash==0 || (h->nhash & (h->nhash-1)) || h->pool==0 || h->nstr > len || h->nrec > len || h->nhash > len ||
+       len != sizeof(*h) + sizeof(uint32_t)*(size_t)h->nstr + sizeof(struct syntaxRecord)*(size_t)h->nrec +
+              sizeof(uint32_t)*2*(size_t)h->nhash + h->pool) return -1;
+    const uint32_t *str=(const uint32_t *)(blob+sizeof(*h));
+    const struct syntaxRecord *rec=(const struct syntaxRecord *)(str+h->nstr);
+    const uint32_t *hash=(const uint32_t *)(rec+h->nrec);
+    const char *pool=(const char *)(hash+2*h->nhash);
+    #define IN_POOL(off) ((off)==SYNTAX_NONE || (off) < h->pool)
+    if(pool[h->pool-1]!='\0') return -1;
+    for(uint32_t i=0; i<h->nstr; i++) if(str[i] >= h->pool) return -1;
+    uint32_t empty=0; //--lookups of unknown extensions stop at an empty slot
+    for(uint32_t i=0; i<h->nhash; i++){
+        if(!IN_POOL(hash[2*i]) || (hash[2*i]!=SYNTAX_NONE && hash[2*i+1] >= h->nrec)) return -1;
+        empty += hash[2*i]==SYNTAX_NONE;
+    }
+    if(!empty) return -1;
+    for(uint32_t k=0; k<h->nrec; k++){
+        const struct syntaxRecord *r=&rec[k];
+        if(r->filetype >= h->pool || !IN_POOL(r->scs) || !IN_POOL(r->mcs) || !IN_POOL(r->mce) ||
+           r->keywords > h->nstr || r->nkeywords > h->nstr-r->keywords ||
+           r->matches > h->nstr || r->nmatches > h->nstr-r->matches || r->first[256]!=r->nkeywords) return -1;
+        for(int c=0; c<256; c++) if(r->first[c] > r->first[c+1]) return -1;
+    }
+    #undef IN_POOL
+    
+    struct syntaxDb *db=&syntax_db;
+    db->blob=blob;
+    db->h=h;
+    db->hash=hash;
+    db->pool=pool;
+    db->n=h->nrec;
+    db->syntax=calloc(h->nrec+1, sizeof(struct editorSyntax));
+    db->lists=malloc(sizeof(char *)*(h->nstr+2*h->nrec+1));
+    char **l=db->lists;
+    #define POOL(off) ((off)==SYNTAX_NONE ? NULL : (char *)pool+(off))
+    for(uint32_t k=0; k<h->nrec; k++){
+        const struct syntaxRecord *r=&rec[k];
+        struct editorSyntax *s=&db->syntax[k];
+        s->filetype=POOL(r->filetype);
+        s->singleline_comment_start=POOL(r->scs);
+        s->multiline_comment_start=POOL(r->mcs);
+        s->multiline_comment_end=POOL(r->mce);
+        s->flags=r->flags;
+        s->first=r->first;
+        s->quote=r->quote;
+        s->separator=r->separator;
+        s->keywords=l;
+        for(uint32_t i=0; i<r->nkeywords; i++) *l++=POOL(str[r->keywords+i]);
+        *l++=NULL;
+        s->filematch=l;
+        for(uint32_t i=0; i<r->nmatches; i++) *l++=POOL(str[r->matches+i]);
+        *l++=NULL;
+    }
+    #undef POOL
+    return 0;
+}
+
+char *editorSyntaxDir(){
+    const char *dir=getenv("KILO_SYNTAX");
+    if(dir) return strdup(dir);
+    const char *home=getenv("HOME");
+    if(!home) return NULL;
+    char *path=malloc(strlen(home)+sizeof(KILO_SYNTAX_DIR)+1);
+    sprintf(path, "%s/%s", home, KILO_SYNTAX_DIR);
+    return path;
+}
+
+int editorSyntaxNameCompare(const void *a, const void *b){
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ -->the definition files of dir in name order, and a stamp of their names,
+    sizes and modification times that any change to them changes
+ */
+char **editorSyntaxFiles(const char *dir, int *n, uint64_t *stamp){
+    *n=0;
+    *stamp=editorHashBlock(kilo_builtin_syntax, strlen(kilo_builtin_syntax));
+    DIR *d = dir ? opendir(dir) : NULL;
+    if(!d) return NULL;
+    char **names=NULL;
+    struct dirent *de;
+    size_t slen=strlen(KILO_SYNTAX_SUFFIX);
+    while((de = readdir(d)) != NULL){
+        size_t len=strlen(de->d_name);
+        if(len<=slen || strcmp(de->d_name+len-slen, KILO_SYNTAX_SUFFIX)) continue;
+        char *path=malloc(strlen(dir)+len+2);
+        sprintf(path, "%s/%s", dir, de->d_name);
+        struct stat st;
+        if(stat(path, &st)==-1){
+            free(path);
+            continue;
+        }
+        long long id[2]={st.st_size, st.st_mtime};
+        *stamp += editorHashBlock(de->d_name, len) ^ editorHashBlock((const char *)id, sizeof(id));
+        names=realloc(names, sizeof(char *)*(*n+1));
+        names[(*n)++]=path;
+    }
+    closedir(d);
+    qsort(names, *n, sizeof(char *), editorSyntaxNameCompare);
+    return names;
+}
+
+int editorSyntaxCacheLoad(const char *path, uint64_t stamp){
+    int fd=open(path, O_RDONLY);
+    if(fd==-1) return -1;
+    struct stat st;
+    char *blob=NULL;
+    int ok = fstat(fd, &st)!=-1 && st.st_size >= (off_t)sizeof(struct syntaxHeader) &&
+             (blob=malloc(st.st_size)) != NULL && read(fd, blob, st.st_size)==st.st_size &&
+             ((struct syntaxHeader *)blob)->stamp==stamp && editorSyntaxUse(blob, st.st_size)==0;
+    close(fd);
+    if(!ok) free(blob);
+    return ok ? 0 : -1;
+}
+
+void editorSyntaxCacheSave(const char *path, const char *blob, size_t len){
+    char *tmp=malloc(strlen(path)+5);
+    sprintf(tmp, "%s.tmp", path);
+    int fd=open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd!=-1){ //--written aside and renamed, as the index cache is
+        int ok = write(fd, blob, len)==(ssize_t)len;
+        close(fd);
+        if(!ok || rename(tmp, path)==-1) unlink(tmp);
+    }
+    free(tmp);
+}
+
+/*
+ -->the syntax database: the compiled cache if it is still up to date,
+    else the built-in definitions and the files are parsed, compiled and
+    the cache is written for the next start
+ */
+void editorSyntaxLoad(){
+    if(syntax_db.ready) return;
+    syntax_db.ready=1;
+    
+    char *dir=editorSyntaxDir();
+    int n;
+    uint64_t stamp;
+    char **files=editorSyntaxFiles(dir, &n, &stamp);
+    char *cache=NULL;
+    if(files){
+        cache=malloc(strlen(dir)+sizeof(KILO_SYNTAX_CACHE)+1);
+        sprintf(cache, "%s/%s", dir, KILO_SYNTAX_CACHE);
+    }
+    
+    if(!cache || editorSyntaxCacheLoad(cache, stamp)==-1){
+        struct syntaxBuild b;
+        memset(&b, 0, sizeof(b));
+        editorSyntaxParse(&b, kilo_builtin_syntax, strlen(kilo_builtin_syntax), "built-in");
+        for(int k=0; k<n; k++){
+            FILE *fp=fopen(files[k], "r");
+            if(!fp) continue;
+            struct abuf text=ABUF_INIT;
+            char chunk[4096];
+            size_t got;
+            while((got = fread(chunk, 1, sizeof(chunk), fp)) > 0) abAppend(&text, chunk, got);
+            fclose(fp);
+            editorSyntaxParse(&b, text.b, text.len, files[k]);
+            abFree(&text);
+        }
+        size_t len;
+        char *blob=editorSyntaxLayout(&b, stamp, &len);
+        if(editorSyntaxUse(blob, len)==0){
+            if(cache) editorSyntaxCacheSave(cache, blob, len);
+        }else{
+            free(blob);
+        }
+        abFree(&b.pool);
+        free(b.str);
+        free(b.rec);
+        free(b.kw);
+        free(b.match);
+    }
+    for(int k=0; k<n; k++) free(files[k]);
+    free(files);
+    free(cache);
+    free(dir);
+}
+
+struct editorSyntax *editorSyntaxByExtension(const char *ext, size_t len){
+    struct syntaxDb *db=&syntax_db;
+    if(!db->blob) return NULL;
+    uint32_t mask=db->h->nhash-1;
+    for(uint32_t slot=editorHashBlock(ext, len) & mask; db->hash[2*slot]!=SYNTAX_NONE; slot=(slot+1) & mask){
+        const char *key=db->pool+db->hash[2*slot];
+        if(strlen(key)==len && !memcmp(key, ext, len)) return &db->syntax[db->hash[2*slot+1]];
+    }
+    return NULL;
+}
+
+/*
+ -->everything of a definition that highlighting reads, hashed: what was
+    derived with it, like the comment states of an index cache, is only
+    valid for the same hash. 0 for no definition.
+ */
+uint64_t editorSyntaxHash(const struct editorSyntax *s){
+    if(!s) return 0;
+    const char *str[4]={s->filetype, s->singleline_comment_start,
+                        s->multiline_comment_start, s->multiline_comment_end};
+    uint64_t h=editorHashBlock((const char *)&s->flags, sizeof(s->flags));
+    for(int k=0; k<4; k++)
+        h = h*0x100000001b3ULL ^ (str[k] ? editorHashBlock(str[k], strlen(str[k])+1) : 0);
+    for(char **kw=s->keywords; *kw; kw++)
+        h = h*0x100000001b3ULL ^ editorHashBlock(*kw, strlen(*kw)+1);
+    h = h*0x100000001b3ULL ^ editorHashBlock((const char *)s->quote, 256);
+    h = h*0x100000001b3ULL ^ editorHashBlock((const char *)s->separator, 256);
+    return h;
+}
+
+/* syntax highlighting*/
+
+/*
+ -->the bracket summary of a row, from its highlighting so that brackets in
+    strings and comments don't count. Kept up to date in the index while the
+    row is covered by it.
+ */
+void editorRowCountBrackets(erow *row){
+    struct bracketSum sum={0, 0, 0};
+    for(int i=0; i<row->rsize; i++){
+        int d=editorBracketDelta(row, i);
+        if(!d) continue;
+        sum.net+=d;
+        if(sum.net<sum.low) sum.low=sum.net;
+    }
+    int suffix=0;
+    for(int i=row->rsize-1; i>=0; i--){
+        suffix+=editorBracketDelta(row, i);
+        if(suffix>sum.high) sum.high=suffix;
+    }
+    int changed = memcmp(&sum, &row->brace, sizeof(sum))!=0;
+    row->brace=sum;
+    if(changed && row->idx < E.brackets.valid) editorBracketUpdate(row->idx);
+}
+
+/*
+ -->highlights a single row starting in the given comment state and reports
+    whether its hl_open_comment state changed, in which case the rows below
+    have to be looked at again
+ */
+int editorHighlightRowFrom(erow *row, int in_comment){
+    if(!row->render) editorUpdateRender(row); //--dropped by the memory budget
+    if(!row->hl) editorMemAdd(MEM_HL, row->rsize+1);
+    row->hl = realloc(row->hl, row->rsize+1);
+    memset(row->hl, HL_NORMAL, row->rsize);//--an unlighted charachter will have a
+    //value of HL_NORMAL in hl
+    
+    if(E.syntax == NULL){
+        editorRowCountBrackets(row);
+        return 0;
+    }
+    
+    char **keywords = E.syntax->keywords; //alias
+    const uint16_t *first = E.syntax->first;
+    const unsigned char *sep = E.syntax->separator;
+    
+    char *scs = E.syntax->singleline_comment_start; //alias
+    char *mcs =E.syntax->multiline_comment_start;
+    char *mce =E.syntax->multiline_comment_end;
+    
+    int scs_len= scs ? strlen(scs) : 0;
+    int mcs_len= mcs ? strlen(mcs) : 0;
+    int mce_len= mce ? strlen(mce) : 0;
+    
+    int prev_step=1; //--the begginig of a line is a separator
+    int in_string=0;
+    
+    int i=0;
+    while(i<row->rsize){
+        char c=row->render[i];
+        unsigned char prev_hl = (i>0)? row->hl[i-1] : HL_NORMAL;
+        
+        //--decide if we should hl single-line comments and also check if we re not in a string
+        if(scs_len && !in_string && !in_comment){
+            if(!strncmp(&row->render[i], scs, scs_len)){
+                memset(&row->hl[i], HL_COMMENT, row->rsize-i);
+                break;
+            }
+        }
+        
+        //--both should be non NULL to hl a multicomment. Is necessary to not be in a string
+        if(mcs_len && mce_len && !in_string){
+            if(in_comment){
+                //--if we're inside a multiline comment, just hl the content
+                row->hl[i] = HL_MLCOMMENT;
+                //--checking the final state of the multiline comment
+                if(!strncmp(&row->render[i], mce, mce_len)){
+                    //--if so, hl the whole mce stirng
+                    memset(&row->hl[i], HL_MLCOMMENT, mce_len);
+                    i+=mce_len; //--consume it
+                    in_comment=0;
+                    prev_step=1;
+                    continue;
+                }else{ //--if we're not at the end, simply consume the current character
+                    i++;
+                    continue;
+                }
+            }else if(!strncmp(&row->render[i], mcs, mcs_len)){
+                //--we're at the start of a multiline comment
+                memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
+                i+=mcs_len;
+                in_comment=1;
+                continue;
+            }
+        }
+        
+        if(E.syntax->flags & HL_HIGHLIGHT_STRING){
+            //--if set, the current character can be hl with HL_STRING
+            //if not, check if we're at the beggining of a string by checking single/double quote
+            if(in_string){
+                //--if we're in a string and the current ch is a backslach \ and
+                //there is at least one more ch line afte \, we highlight the ch that comes afte \.
+                row->hl[i]=HL_STRING;
+                if(c=='\\' && i+1<row->rsize){
+                    row->hl[i+1] =HL_STRING;
+                    i+=2;
+                    continue;
+                }
+                //--if the current character is closing quote, reset the in_string
+                if(c==in_string) in_string=0;
+                i++;//--consume the character
+                prev_step = 1; //--closing character is considered a separator
+                continue;
+            }else{
+                if(E.syntax->quote[(unsigned char)c]){
+                    in_string = c;
+                    row->hl[i]=HL_STRING;
+                    i++;
+                    continue;
+                }
+            }
+        }
+        
+        //--check if the numbers should be hl in this text
+        if(E.syntax->flags & HL_HIGHLIGHT_NUMBERS){
+            //--to highlight a digit is required that the prev character is either a separator
+            //or to be already highlighted
+            if((isdigit(c) && (prev_step || prev_hl == HL_NUMBER)) ||
+               (c=='.' && prev_hl==HL_NUMBER)){
+                row->hl[i] = HL_NUMBER;
+                i++; //--consume the character
+                prev_step=0; //--this indicate that we are in the middle of highlighting something
+                continue;
+            }
+        }
+        
+        //--only if a separator came before, then we can consider a data type
+        if(prev_step){
+            int j, last=first[(unsigned char)c+1]; //--only those starting with c
+            for(j=first[(unsigned char)c]; j<last; j++){
+                int klen = strlen(keywords[j]);
+                int kw2 = keywords[j][klen-1]=='|';
+                if(kw2) klen--;
+                
+                //--check if a keyword exists at our position in the text and we check
+                //to see if a separator character comes after the keyword
+                if(!strncmp(&row->render[i], keywords[j], klen) &&
+                   sep[(unsigned char)row->render[i+klen]]){
+                    //--passed, meaning that we have a word to hl
+                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+                    i+=klen; //--consume the entire keyword
+                    break;
+                }
+            }
+            if(j<last){
+                prev_step=0;
+                continue; //if the for loop broke
+            }
+        }
+        
+        prev_step=sep[(unsigned char)c];
+        i++;
+    }
+    
+    editorRowCountBrackets(row);
+    int changed =(row->hl_open_comment != in_comment);
+    row->hl_open_comment = in_comment; //--tells if the row ended as an unclosed multiline comment or not
+    return changed;
+}
+
+int editorHighlightRow(erow *row){
+    //--in_comment is true if the previous line has an unclosed multiline comment
+    return editorHighlightRowFrom(row, row->idx >0 && E.row[row->idx-1].hl_open_comment);
+}
+
+void editorUpdateSyntax(erow *row){
+    long long t = LATENCY_BEGIN();
+    //--if there is a next line and the state of hl_open_comment changed, go on
+    //with it (a loop, a long comment block would otherwise blow the stack)
+    while(editorHighlightRow(row) && row->idx+1 < E.numrows)
+        row=&E.row[row->idx+1];
+    LATENCY_END(PROBE_SYNTAX, t);
+}
+
+int editorSyntaxToColor(int hl){
+    switch (hl) {
+        case HL_COMMENT:
+        case HL_MLCOMMENT:
+            return 36; //--cyan
+        case HL_KEYWORD1:
+            return 33; //--yellow
+        case HL_KEYWORD2:
+            return 32; //--green
+        case HL_STRING:
+            return 35; //--magneta
+        case HL_NUMBER:
+            return 31;
+        case HL_MATCH:
+            return 34;
+        default:
+            return 37;
+    }
+}
+
+void editorSelectSyntaxHighlight(){
+    E.syntax = NULL; //--if nothing matches there will be no filename/filetype
+    if(E.filename == NULL) return;
+    editorSyntaxLoad();
+    
+    char *ext = strrchr(E.filename, '.'); //--last position of '.' in filename
+    size_t extlen = ext ? strlen(ext) : 0;
+    if(ext && !strcmp(ext, KILO_GZIP_SUFFIX)){ //--foo.c.gz is highlighted as foo.c
+        char *end=ext;
+        ext=NULL;
+        for(char *p=E.filename; p<end; p++)
+            if(*p=='.') ext=p;
+        extlen = ext ? (size_t)(end-ext) : 0;
+    }
+    
+    //--one hash lookup for the extension, else the patterns that may be
+    //anywhere in the filename
+    struct editorSyntax *s = ext ? editorSyntaxByExtension(ext, extlen) : NULL;
+    for(int j=0; !s && j<syntax_db.n; j++)
+        for(int i=0; !s && syntax_db.syntax[j].filematch[i]; i++){
+            char *match=syntax_db.syntax[j].filematch[i];
+            if(match[0]!='.' && strstr(E.filename, match)) s=&syntax_db.syntax[j];
+        }
+    if(s == NULL) return;
+    E.syntax = s;
+    
+    //--the hl immediately changes when the filetype changes
+    int filerow;
+    for(filerow=0; filerow< E.numrows; filerow++){
+        editorUpdateSyntax(&E.row[filerow]);
+    }
+}
+
+/* journal */
+
+long long editorMonotonicMs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+char *editorJournalPath(const char *filename){
+    char *path = malloc(strlen(filename) + sizeof(KILO_JOURNAL_SUFFIX));
+    strcpy(path, filename);
+    strcat(path, KILO_JOURNAL_SUFFIX);
+    return path;
+}
+
+void editorJournalPut(const void *s, int len){
+    struct editorJournal *j = &E.journal;
+    if(j->len + len > j->cap){
+        j->cap = (j->len + len)*2;
+        j->buf = realloc(j->buf, j->cap);
+    }
+    memcpy(&j->buf[j->len], s, len);
+    j->len += len;
+}
+
+void editorJournalPutVarint(unsigned long long v){
+    unsigned char b[10]; //--LEB128: 7 bits per byte, high bit = more follows
+    int n=0;
+    do{
+        b[n] = v & 0x7f;
+        v >>= 7;
+        if(v) b[n] |= 0x80;
+        n++;
+    }while(v);
+    editorJournalPut(b, n);
+}
+
+/*
+ -->the header pins the journal to the exact file it was started against:
+    magic, then size and mtime of the file on disk as varints
+ */
+void editorJournalPutHeader(){
+    struct stat st;
+    if(stat(E.filename, &st) == -1){
+        st.st_size=0;
+        st.st_mtime=0;
+    }
+    editorJournalPut(KILO_JOURNAL_MAGIC, 4);
+    editorJournalPutVarint(st.st_size);
+    editorJournalPutVarint(st.st_mtime);
+}
+
+int editorJournalOpen(){
+    if(E.journal.fd != -1) return 0;
+    if(E.filename == NULL) return -1;
+    
+    char *path = editorJournalPath(E.filename);
+    E.journal.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    free(path);
+    if(E.journal.fd == -1) return -1;
+    
+    editorJournalPutHeader();
+    E.journal.last_sync = editorMonotonicMs();
+    return 0;
+}
+
+void editorJournalRecord(int op, int row, int at, const char *s, size_t len){
+    if(E.journal.suspended) return;
+    if(editorJournalOpen() == -1) return;
+    
+    unsigned char tag = op;
+    editorJournalPut(&tag, 1);
+    editorJournalPutVarint(row);
+    editorJournalPutVarint(at);
+    editorJournalPutVarint(len);
+    if(s) editorJournalPut(s, len); //--only the insert ops carry text
+}
+
+void editorJournalSync(){
+    struct editorJournal *j = &E.journal;
+    if(j->fd == -1) return;
+    
+    //--hand the pending records to the kernel right away, a crash of kilo
+    //itself can then no longer lose them
+    int off=0;
+    while(off < j->len){
+        ssize_t n = write(j->fd, &j->buf[off], j->len-off);
+        if(n == -1){
+            if(errno == EINTR) continue;
+            editorSetStatusMessage("Journal write failed: %s", strerror(errno));
+            break;
+        }
+        off += n;
+    }
+    if(j->len) j->unsynced = 1;
+    j->len = 0;
+    
+    //--fdatasync is the expensive part, batch it
+    long long now = editorMonotonicMs();
+    if(j->unsynced && now - j->last_sync >= KILO_JOURNAL_SYNC_MS){
+        fdatasync(j->fd);
+        j->unsynced = 0;
+        j->last_sync = now;
+    }
+}
+
+void editorJournalDiscard(){
+    if(E.journal.fd != -1){
+        close(E.journal.fd);
+        E.journal.fd = -1;
+    }
+    E.journal.len = 0;
+    E.journal.unsynced = 0;
+    if(E.filename){
+        char *path = editorJournalPath(E.filename);
+        unlink(path);
+        free(path);
+    }
+}
+
+/* row operations*/
+
+int editorRowCxToRx(erow *row, int cx){
+    int rx=0;
+    int j;
+    for(j=0;j<cx; j++){
+        if(row->chars[j]=='\t') // if we are on a tab character, we're going right in the back of the next TAB character
+            rx+=(KILO_TAB_STOP-1)-(rx%KILO_TAB_STOP);
+        rx++;
+    }
+    return rx;
+}
+
+int editorRowRxtoCx(erow *row, int rx){
+    int cur_rx = 0;
+    int cx;
+    for(cx=0; cx<row->size; cx++){
+        if(row->chars[cx] == '\t')
+            cur_rx += (KILO_TAB_STOP -1) - (cur_rx%KILO_TAB_STOP);
+        cur_rx++;
+        
+        if(cur_rx >rx) return cx;
+    }
+    return cx;
+}
+
+void editorUpdateRender(erow *row){
+    int tabs=0;
+    int j;
+    for(j=0; j<row->size; j++)
+        if(row->chars[j]=='\t') tabs++;
+    
+    int oldsize=row->rsize;
+    //--hl is sized for the old render, editorHighlightRowFrom makes a new one
+    if(row->render) editorMemAdd(MEM_RENDER, -(row->rsize+1));
+    if(row->hl) editorMemAdd(MEM_HL, -(row->rsize+1));
+    free(row->render);
+    free(row->hl);
+    row->hl=NULL;
+    row->render=malloc(row->size+tabs*(KILO_TAB_STOP-1)+1);
+    
+    int idx=0;
+    for(j=0; j<row->size; j++){
+        if(row->chars[j]=='\t'){
+            row->render[idx++]=' ';
+            while(idx% KILO_TAB_STOP !=0) row->render[idx++] = ' ';
+        }else{
+            row->render[idx++]=row->chars[j];
+        }
+    }
+    row->render[idx]='\0';
+    row->rsize=idx;
+    editorMemAdd(MEM_RENDER, idx+1);
+    if(E.view.wrap && !row->hidden && row->idx < E.view.valid)
+        editorViewUpdate(row->idx, editorWrapSegs(idx) - editorWrapSegs(oldsize));
+}
+
+/*
+ -->gives a row whose render and hl were dropped its derived data back; the
+    comment state it keeps is still right, so nothing below has to change
+ */
+void editorRowEnsureDerived(erow *row){
+    if(row->render && row->hl) return;
+    editorHighlightRowFrom(row, row->idx>0 && E.row[row->idx-1].hl_open_comment);
+}
+
+void editorRowDropDerived(erow *row){
+    if(!row->render) return;
+    editorMemAdd(MEM_RENDER, -(row->rsize+1));
+    if(row->hl) editorMemAdd(MEM_HL, -(row->rsize+1));
+    free(row->render);
+    free(row->hl);
+    row->render=NULL;
+    row->hl=NULL;
+    E.mem.dropped++;
+}
+
+void editorUpdateRow(erow *row){
+    editorDiffTouch(row->idx, E.numrows-1-row->idx);
+    editorDiffRowChanged(row->idx);
+    editorUpdateRender(row);
+    editorUpdateSyntax(row); //makes sense to update the hl array here
+}
+
+void editorInsertRow(int at, char *s, size_t len){
+    if(at<0 || at> E.numrows) return;
+    
+    E.row = realloc(E.row, sizeof(erow)*(E.numrows+1));
+    editorViewInvalidate(at);
+    editorBracketInvalidate(at);
+    editorMemAdd(MEM_ROWS, (long long)sizeof(erow)*(E.numrows+1) - E.rowbytes);
+    E.rowbytes = sizeof(erow)*(E.numrows+1);
+    memmove(&E.row[at+1], &E.row[at], sizeof(erow)*(E.numrows-at));
+    for(int j=at+1; j<=E.numrows; j++) E.row[j].idx++;
+    
+    E.row[at].idx=at; //--initialize to the rows index in the file at the time is inserted
+    
+    E.row[at].size = len;
+    E.row[at].chars = malloc(len+1);
+    editorMemAdd(MEM_CHARS, len+1);
+    memcpy(E.row[at].chars, s, len);
+    E.row[at].chars[len] = '\0';
+    
+    E.row[at].rsize=0;
+    E.row[at].render=NULL;
+    E.row[at].hl=NULL;
+    E.row[at].hl_open_comment=0;
+    memset(&E.row[at].brace, 0, sizeof(struct bracketSum));
+    E.row[at].hidden=0;
+    if(E.view.nfolds) editorFoldRowInserted(at);
+    editorDiffRowInserted(at);
+    editorUpdateRow(&E.row[at]);
+    
+    E.numrows++;
+    E.dirty++;
+    editorJournalRecord(JOURNAL_ROW_INSERT, at, 0, s, len);
+    editorUndoRecord(UNDO_ROW_INSERT, at, 0, NULL, len);
+}
+
+void editorFreeRow(erow *row){
+    if(row->chars) editorMemAdd(MEM_CHARS, -(row->size+1));
+    if(row->render) editorMemAdd(MEM_RENDER, -(row->rsize+1));
+    if(row->hl) editorMemAdd(MEM_HL, -(row->rsize+1));
+    free(row->render);
+    free(row->chars);
+    free(row->hl);
+}
+
+void editorDelRow(int at){
+    if(at<0 || at>=E.numrows) return;
+    editorUndoRowDel(&E.row[at]); //--may keep chars by reference
+    editorFreeRow(&E.row[at]);
+    editorViewInvalidate(at);
+    editorBracketInvalidate(at);
+    memmove(&E.row[at], &E.row[at+1], sizeof(erow)*(E.numrows-at-1));
+    for(int j=at; j<E.numrows-1; j++) E.row[j].idx--;
+    E.numrows--;
+    if(E.view.nfolds) editorFoldRowDeleted(at);
+    editorDiffRowDeleted(at);
+    editorDiffTouch(at, E.numrows-at);
+    E.dirty++;
+    editorJournalRecord(JOURNAL_ROW_DEL, at, 0, NULL, 0);
+}
+
+void editorRowInsertString(erow *row, int at, const char *s, size_t len){
+    if(len==0) return;
+    if( at<0 || at > row->size) at= row->size;
+    row->chars = realloc(row->chars, row->size+len+1);
+    editorMemAdd(MEM_CHARS, len);
+    memmove(&row->chars[at+len], &row->chars[at], row->size-at+1);
+    memcpy(&row->chars[at], s, len);
+    row->size+=len;
+    editorUpdateRow(row); //update render & rsize
+    E.dirty++;
+    editorJournalRecord(JOURNAL_TEXT_INSERT, row->idx, at, s, len);
+    editorUndoRecord(UNDO_TEXT_INSERT, row->idx, at, NULL, len);
+}
+
+void editorRowDelString(erow *row, int at, int len){
+    if(at<0 || len<=0 || at+len>row->size) return;
+    editorUndoRecord(UNDO_TEXT_DEL, row->idx, at, &row->chars[at], len);
+    memmove(&row->chars[at], &row->chars[at+len], row->size-at-len+1);
+    row->size-=len;
+    editorMemAdd(MEM_CHARS, -len); //--the block is not shrunk, the next insert reuses it
+    editorUpdateRow(row);
+    E.dirty++;
+    editorJournalRecord(JOURNAL_TEXT_DEL, row->idx, at, NULL, len);
+}
+
+void editorRowInsertChar(erow *row, int at, int c){
+    char ch=c;
+    editorRowInsertString(row, at, &ch, 1);
+}
+
+void editorRowAppendString(erow *row, char *s, size_t len){
+    editorRowInsertString(row, row->size, s, len);
+}
+
+void editorRowDelChar(erow *row, int at){
+    editorRowDelString(row, at, 1);
+}
+
+/*editor Operations*/
+
+void editorInsertChar(int c){
+    if(E.cy == E.numrows) editorInsertRow(E.numrows, "", 0); //finale line
+    editorRowInsertChar(&E.row[E.cy], E.cx, c);
+    E.cx++;
+}
+
+void editorInsertNewline(){
+    if(E.cx==0){
+        editorInsertRow(E.cy, "", 0);
+    }else{
+        erow *row=&E.row[E.cy];
+        editorInsertRow(E.cy+1, &row->chars[E.cx], row->size-E.cx);
+        row=&E.row[E.cy];
+        editorRowDelString(row, E.cx, row->size-E.cx);
+    }
+    E.cy++;
+    E.cx=0;
+}
+
+void editorDelChar(){
+    if(E.cy==E.numrows) return;
+    if(E.cx==0 && E.cy==0) return;
+    
+    erow *row = &E.row[E.cy];
+    if(E.cx>0){
+        editorRowDelChar(row, E.cx-1);
+        E.cx--;
+    }else{
+        E.cx =E.row[E.cy-1].size;
+        editorRowAppendString(&E.row[E.cy-1], row->chars, row->size);
+        editorDelRow(E.cy);
+        E.cy--;
+    }
+}
+
+/* undo */
+
+char *editorUndoAlloc(int len, undoChunk **chunk){
+    struct editorUndo *u=&E.undo;
+    if(u->chunk==NULL || u->chunk->cap - u->chunk->used < len){
+        if(u->chunk && u->chunk->refs==0){
+            u->bytes -= sizeof(undoChunk)+u->chunk->cap;
+            free(u->chunk);
+        }
+        int cap = len > KILO_UNDO_CHUNK ? len : KILO_UNDO_CHUNK;
+        u->chunk = malloc(sizeof(undoChunk)+cap);
+        u->chunk->used=0;
+        u->chunk->cap=cap;
+        u->chunk->refs=0;
+        u->bytes += sizeof(undoChunk)+cap;
+    }
+    *chunk = u->chunk;
+    u->chunk->refs++;
+    char *p = &u->chunk->data[u->chunk->used];
+    u->chunk->used += len;
+    return p;
+}
+
+void editorUndoRelease(undoRecord *r){
+    struct editorUndo *u=&E.undo;
+    if(r->order){
+        u->bytes -= editorRowOrderBytes(r->order);
+        editorRowOrderFree(r->order);
+        r->order=NULL;
+    }
+    if(r->data==NULL) return;
+    if(r->chunk){
+        if(--r->chunk->refs==0 && r->chunk!=u->chunk){
+            u->bytes -= sizeof(undoChunk)+r->chunk->cap;
+            free(r->chunk);
+        }
+    }else{
+        u->bytes -= r->len+1;
+        free(r->data);
+    }
+    r->data=NULL;
+    r->chunk=NULL;
+}
+
+void editorUndoEvict(){
+    struct editorUndo *u=&E.undo;
+    //--oldest groups go first, but never the one just made
+    while(u->bytes > KILO_UNDO_LIMIT && u->first < u->pos &&
+          u->rec[u->first].group != u->rec[u->pos-1].group){
+        int group=u->rec[u->first].group;
+        while(u->first < u->pos && u->rec[u->first].group==group)
+            editorUndoRelease(&u->rec[u->first++]);
+    }
+}
+
+undoRecord *editorUndoPush(int op, int row, int at, int len){
+    struct editorUndo *u=&E.undo;
+    
+    //--a new edit makes everything that was undone unreachable
+    while(u->n > u->pos) editorUndoRelease(&u->rec[--u->n]);
+    
+    if(u->n == u->cap){
+        if(u->first > u->cap/2){ //--slide the evicted prefix away
+            memmove(u->rec, &u->rec[u->first], sizeof(undoRecord)*(u->n-u->first));
+            u->n -= u->first;
+            u->pos -= u->first;
+            u->first=0;
+        }else{
+            u->bytes -= sizeof(undoRecord)*u->cap;
+            u->cap = u->cap ? u->cap*2 : 256;
+            u->rec = realloc(u->rec, sizeof(undoRecord)*u->cap);
+            u->bytes += sizeof(undoRecord)*u->cap;
+        }
+    }
+    
+    if(u->newgroup || u->pos==u->first) u->group++;
+    u->newgroup=0;
+    
+    undoRecord *r = &u->rec[u->n++];
+    u->pos = u->n;
+    r->op=op;
+    r->group=u->group;
+    r->row=row;
+    r->at=at;
+    r->len=len;
+    r->data=NULL;
+    r->chunk=NULL;
+    r->order=NULL;
+    r->cx=u->kcx;
+    r->cy=u->kcy;
+    r->acx=u->kcx;
+    r->acy=u->kcy;
+    u->sealed=0;
+    u->touched=1;
+    return r;
+}
+
+/*
+ -->called by the row operations. Inserts only remember where the text went,
+    the text itself is still in the buffer; deleted text is copied into the
+    arena. Runs of typing, backspacing and deleting extend the top record.
+ */
+void editorUndoRecord(int op, int row, int at, const char *s, int len){
+    struct editorUndo *u=&E.undo;
+    if(u->suspended) return;
+    
+    undoRecord *top = (u->pos > u->first && u->pos==u->n && !u->sealed) ? &u->rec[u->pos-1] : NULL;
+    if(top && top->op==UNDO_ROW_INSERT && op==UNDO_TEXT_INSERT && top->row==row){
+        //--text typed into a row just inserted: undoing the row takes it along
+        u->newgroup=0;
+        u->touched=1;
+        return;
+    }
+    if(top && top->op==op && top->row==row){
+        if(op==UNDO_TEXT_INSERT && at==top->at+top->len){
+            top->len+=len;
+            u->newgroup=0;
+            u->touched=1;
+            return;
+        }
+        undoChunk *c = top->chunk;
+        if(op==UNDO_TEXT_DEL && c && c==u->chunk && c->cap-c->used >= len &&
+           top->data+top->len == &c->data[c->used]){
+            if(at==top->at){ //--DEL key: the text comes after the run
+                memcpy(&top->data[top->len], s, len);
+            }else if(at+len==top->at){ //--backspace: it comes before
+                memmove(&top->data[len], top->data, top->len);
+                memcpy(top->data, s, len);
+                top->at=at;
+            }else{
+                c=NULL;
+            }
+            if(c){
+                c->used+=len;
+                top->len+=len;
+                u->newgroup=0;
+                u->touched=1;
+                return;
+            }
+        }
+    }
+    
+    undoRecord *r = editorUndoPush(op, row, at, len);
+    if(op==UNDO_TEXT_DEL){
+        r->data = editorUndoAlloc(len, &r->chunk);
+        memcpy(r->data, s, len);
+    }
+    editorUndoEvict();
+}
+
+void editorUndoRowDel(erow *row){
+    struct editorUndo *u=&E.undo;
+    if(u->suspended) return;
+    undoRecord *r = editorUndoPush(UNDO_ROW_DEL, row->idx, 0, row->size);
+    r->data = row->chars; //--taken by reference, not copied
+    row->chars = NULL;
+    editorMemAdd(MEM_CHARS, -(r->len+1));
+    u->bytes += r->len+1;
+    editorUndoEvict();
+}
+
+void editorUndoBeginKey(){
+    struct editorUndo *u=&E.undo;
+    long long now = editorMonotonicMs();
+    if(now - u->last_key > KILO_UNDO_GROUP_MS && !u->manual) u->newgroup=1;
+    u->last_key = now;
+    u->kcx=E.cx;
+    u->kcy=E.cy;
+    u->touched=0;
+}
+
+void editorUndoBreak(){
+    E.undo.newgroup=1;
+    E.undo.sealed=1; //--not even a typing run goes on across it
+}
+
+void editorUndoEndKey(){
+    struct editorUndo *u=&E.undo;
+    if(u->touched){
+        u->rec[u->pos-1].acx=E.cx;
+        u->rec[u->pos-1].acy=E.cy;
+    }
+}
+
+/*
+ -->undoing an insert or redoing a delete takes text out of the buffer and
+    into the record, the other two directions put it back
+ */
+void editorUndoApply(undoRecord *r, int undo){
+    if(r->op==UNDO_ROW_ORDER){ //--both ways the record becomes its own inverse
+        rowOrder *inv=calloc(1, sizeof(rowOrder));
+        E.undo.bytes -= editorRowOrderBytes(r->order);
+        editorRowsApply(r->order, inv);
+        editorRowOrderFree(r->order);
+        r->order=inv;
+        E.undo.bytes += editorRowOrderBytes(inv);
+        return;
+    }
+    int remove = (r->op==UNDO_TEXT_INSERT || r->op==UNDO_ROW_INSERT) == undo;
+    
+    if(r->op==UNDO_TEXT_INSERT || r->op==UNDO_TEXT_DEL){
+        if(r->row >= E.numrows) return;
+        erow *row = &E.row[r->row];
+        if(remove){
+            r->data = editorUndoAlloc(r->len, &r->chunk);
+            memcpy(r->data, &row->chars[r->at], r->len);
+            editorRowDelString(row, r->at, r->len);
+        }else{
+            editorRowInsertString(row, r->at, r->data, r->len);
+            editorUndoRelease(r);
+        }
+    }else{
+        if(remove){
+            if(r->row >= E.numrows) return;
+            r->data = E.row[r->row].chars;
+            r->len = E.row[r->row].size;
+            E.row[r->row].chars = NULL;
+            editorMemAdd(MEM_CHARS, -(r->len+1));
+            E.undo.bytes += r->len+1;
+            editorDelRow(r->row);
+        }else{
+            editorInsertRow(r->row, r->data, r->len);
+            editorUndoRelease(r);
+        }
+    }
+}
+
+/*
+ -->a run of row records, next in the direction being applied, that adds or
+    removes one contiguous block of rows goes through editorRowsApply as a
+    single splice: undoing a paste of n lines is O(n + rows) instead of n
+    moves of the whole row array. Returns the records it applied, 0 when the
+    run is shorter than KILO_UNDO_SPLICE and they are better done one by one.
+ */
+int editorUndoSplice(int undo){
+    struct editorUndo *u=&E.undo;
+    int step = undo ? -1 : 1;
+    int start = undo ? u->pos-1 : u->pos;
+    int end = undo ? u->first-1 : u->n;
+    undoRecord *r=&u->rec[start];
+    if(r->op!=UNDO_ROW_INSERT && r->op!=UNDO_ROW_DEL) return 0;
+    int group=r->group;
+    int remove = (r->op==UNDO_ROW_INSERT) == undo;
+    
+    int avail = undo ? u->pos-u->first : u->n-u->pos;
+    int *blk=malloc(sizeof(int)*(2*avail+1)); //--remove: the row each record takes; insert: records in row order
+    int head=avail, tail=avail;
+    int lo=0, hi=0, taken=0;
+    for(int i=start; i!=end; i+=step, taken++){
+        r=&u->rec[i];
+        if(r->group!=group || (r->op!=UNDO_ROW_INSERT && r->op!=UNDO_ROW_DEL) ||
+           ((r->op==UNDO_ROW_INSERT) == undo) != remove) break;
+        int p=r->row; //--where it applies once the records before it are done
+        if(remove){ //--[lo, hi) in rows as they are now
+            if(taken==0 && p<E.numrows){
+                lo=p;
+                hi=p+1;
+                blk[taken]=p;
+            }else if(taken && p==lo-1){
+                blk[taken]=--lo;
+            }else if(taken && p==lo && hi<E.numrows){
+                blk[taken]=hi++;
+            }else break;
+        }else{ //--the block goes in at lo, blk[head, tail) in row order
+            if(!r->data || r->chunk) break;
+            if(taken==0 && p<=E.numrows){
+                lo=p;
+                blk[tail++]=i;
+            }else if(taken && p==lo+(tail-head)){
+                blk[tail++]=i;
+            }else if(taken && p==lo){
+                blk[--head]=i;
+            }else break;
+        }
+    }
+    if(taken < KILO_UNDO_SPLICE){
+        free(blk);
+        return 0;
+    }
+    
+    rowOrder o;
+    memset(&o, 0, sizeof(o));
+    if(remove){
+        int cut=hi-lo;
+        o.n=E.numrows-cut;
+        o.src=malloc(sizeof(int)*(o.n+1));
+        for(int j=0; j<o.n; j++) o.src[j] = j<lo ? j : j+cut;
+        rowOrder *inv=calloc(1, sizeof(rowOrder)); //--gets the text of the rows that go
+        editorRowsApply(&o, inv);
+        for(int k=0, i=start; k<taken; k++, i+=step){
+            int t=-1-inv->src[blk[k]];
+            u->rec[i].data=inv->text[t]; //--by reference, as editorUndoApply keeps it
+            u->rec[i].len=inv->len[t];
+            u->rec[i].chunk=NULL;
+            inv->text[t]=NULL;
+            u->bytes += u->rec[i].len+1;
+        }
+        editorRowOrderFree(inv);
+    }else{
+        int add=tail-head;
+        o.n=E.numrows+add;
+        o.src=malloc(sizeof(int)*(o.n+1));
+        o.text=malloc(sizeof(char *)*add);
+        o.len=malloc(sizeof(int)*add);
+        o.ntext=add;
+        for(int j=0; j<o.n; j++) o.src[j] = j<lo ? j : j<lo+add ? -1-(j-lo) : j-add;
+        for(int k=0; k<add; k++){
+            r=&u->rec[blk[head+k]];
+            o.text[k]=r->data; //--the rows take it over
+            o.len[k]=r->len;
+            u->bytes -= r->len+1;
+            r->data=NULL;
+        }
+        editorRowsApply(&o, NULL);
+        free(o.text);
+        free(o.len);
+    }
+    free(o.src);
+    free(blk);
+    return taken;
+}
+
+void editorUndoClampCursor(int cx, int cy){
+    E.cy = cy > E.numrows ? E.numrows : cy;
+    int rowlen = E.cy < E.numrows ? E.row[E.cy].size : 0;
+    E.cx = cx > rowlen ? rowlen : cx;
+}
+
+void editorUndo(){
+    struct editorUndo *u=&E.undo;
+    if(u->pos == u->first){
+        editorSetStatusMessage("Nothing to undo");
+        return;
+    }
+    int group = u->rec[u->pos-1].group;
+    u->suspended=1;
+    while(u->pos > u->first && u->rec[u->pos-1].group==group){
+        int spliced=editorUndoSplice(1);
+        if(spliced){
+            u->pos-=spliced;
+            continue;
+        }
+        u->pos--;
+        editorUndoApply(&u->rec[u->pos], 1);
+    }
+    u->suspended=0;
+    u->sealed=1;
+    u->touched=0;
+    editorUndoClampCursor(u->rec[u->pos].cx, u->rec[u->pos].cy);
+}
+
+void editorRedo(){
+    struct editorUndo *u=&E.undo;
+    if(u->pos == u->n){
+        editorSetStatusMessage("Nothing to redo");
+        return;
+    }
+    int group = u->rec[u->pos].group;
+    u->suspended=1;
+    while(u->pos < u->n && u->rec[u->pos].group==group){
+        int spliced=editorUndoSplice(0);
+        if(spliced){
+            u->pos+=spliced;
+            continue;
+        }
+        editorUndoApply(&u->rec[u->pos], 0);
+        u->pos++;
+    }
+    u->suspended=0;
+    u->sealed=1;
+    u->touched=0;
+    editorUndoClampCursor(u->rec[u->pos-1].acx, u->rec[u->pos-1].acy);
+}
+
+void editorUndoClear(){
+    struct editorUndo *u=&E.undo;
+    for(int j=u->first; j<u->n; j++)
+        editorUndoRelease(&u->rec[j]);
+    free(u->chunk);
+    free(u->rec);
+    memset(u, 0, sizeof(*u));
+}
+
+/* line commands */
+
+void editorRowOrderFree(rowOrder *o){
+    if(!o) return;
+    for(int k=0; k<o->ntext; k++) free(o->text[k]);
+    free(o->src);
+    free(o->text);
+    free(o->len);
+    free(o);
+}
+
+long long editorRowOrderBytes(rowOrder *o){
+    long long bytes = sizeof(rowOrder) + (long long)sizeof(int)*o->n +
+                      (long long)(sizeof(char *)+sizeof(int))*o->ntext;
+    for(int k=0; k<o->ntext; k++)
+        if(o->text[k]) bytes += o->len[k]+1;
+    return bytes;
+}
+
+void editorJournalRows(const rowOrder *o){
+    if(E.journal.suspended) return;
+    if(editorJournalOpen() == -1) return;
+    
+    unsigned char tag = JOURNAL_ROW_ORDER;
+    editorJournalPut(&tag, 1);
+    editorJournalPutVarint(0);
+    editorJournalPutVarint(0);
+    editorJournalPutVarint(o->n);
+    for(int j=0; j<o->n; j++){
+        if(o->src[j] >= 0){
+            editorJournalPutVarint(o->src[j]+1);
+        }else{ //--the text is in the row by now
+            editorJournalPutVarint(0);
+            editorJournalPutVarint(E.row[j].size);
+            editorJournalPut(E.row[j].chars, E.row[j].size);
+        }
+    }
+}
+
+/*
+ -->rearranges the rows as o says without copying any text: row entries
+    move, idx is renumbered once, and only rows that now start in another
+    comment state are highlighted again. inv gets what undoes it; without
+    one it goes on the undo log, or the rows that go are freed.
+ */
+void editorRowsApply(rowOrder *o, rowOrder *inv){
+    int oldn=E.numrows;
+    erow *old=E.row;
+    erow *row=malloc(sizeof(erow)*(o->n+1));
+    int *dest=malloc(sizeof(int)*(oldn+1)); //--where each old row went, -1 nowhere
+    unsigned char *instate=malloc(o->n+1); //--comment state it was highlighted in, 2 for none
+    for(int i=0; i<oldn; i++) dest[i]=-1;
+    
+    for(int j=0; j<o->n; j++){
+        int src=o->src[j];
+        if(src >= 0){
+            row[j]=old[src];
+            dest[src]=j;
+            instate[j] = src>0 && old[src-1].hl_open_comment;
+        }else{
+            int k=-1-src;
+            memset(&row[j], 0, sizeof(erow));
+            row[j].chars=o->text[k];
+            row[j].size=o->len[k];
+            o->text[k]=NULL;
+            editorMemAdd(MEM_CHARS, row[j].size+1);
+            instate[j]=2;
+        }
+        row[j].idx=j;
+        row[j].hidden=0;
+    }
+    
+    rowOrder *undo = inv;
+    if(!undo && !E.undo.suspended) undo=calloc(1, sizeof(rowOrder));
+    int gone=0;
+    for(int i=0; i<oldn; i++) gone += dest[i]==-1;
+    if(undo){
+        undo->n=oldn;
+        undo->src=malloc(sizeof(int)*(oldn+1));
+        undo->text=malloc(sizeof(char *)*(gone+1));
+        undo->len=malloc(sizeof(int)*(gone+1));
+        undo->ntext=0;
+    }
+    for(int i=0; i<oldn; i++){
+        if(dest[i] != -1){
+            if(undo) undo->src[i]=dest[i];
+            continue;
+        }
+        if(undo){ //--the text is kept for undo, by reference
+            undo->src[i]=-1-undo->ntext;
+            undo->text[undo->ntext]=old[i].chars;
+            undo->len[undo->ntext++]=old[i].size;
+            editorMemAdd(MEM_CHARS, -(old[i].size+1));
+            old[i].chars=NULL;
+        }
+        editorFreeRow(&old[i]);
+    }
+    free(old);
+    free(dest);
+    E.row=row;
+    E.numrows=o->n;
+    editorMemAdd(MEM_ROWS, (long long)sizeof(erow)*E.numrows - E.rowbytes);
+    E.rowbytes=sizeof(erow)*E.numrows;
+    
+    //--everything indexed by row starts over
+    free(E.view.folds);
+    E.view.folds=NULL;
+    E.view.nfolds=E.view.capfolds=0;
+    editorViewInvalidate(0);
+    editorBracketInvalidate(0);
+    E.diff.nhash=0;
+    editorDiffTouch(0, 0);
+    
+    for(int j=0; j<E.numrows; j++){
+        int in = j>0 && E.row[j-1].hl_open_comment;
+        if(instate[j] != in) editorHighlightRowFrom(&E.row[j], in);
+    }
+    free(instate);
+    
+    E.dirty++;
+    editorJournalRows(o);
+    if(undo && !inv){
+        editorUndoBreak();
+        undoRecord *r=editorUndoPush(UNDO_ROW_ORDER, 0, 0, 0);
+        r->order=undo;
+        E.undo.bytes += editorRowOrderBytes(undo);
+        editorUndoBreak(); //--a group of its own
+        editorUndoEvict();
+    }
+    editorUndoClampCursor(E.cx, E.cy);
+}
+
+struct linesWorker{
+    int from, to; //--rows this worker covers
+    int *src, *tmp; //--sort: row numbers in [from, to), scratch
+    int lo, mid, hi; //--sort: runs to merge
+    uint64_t *hash; //--unique
+    const char *text; //--filter
+    int keep;
+    unsigned char *flag;
+    int n; //--filter: rows kept
+    int *out; //--filter: where they go
+    pthread_t tid;
+    int threaded;
+};
+
+int editorLinesWorkers(int rows){
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int n = rows / KILO_LINES_BLOCK; //--small buffers are done inline
+    if(cpus < 1) cpus=1;
+    if(n > cpus) n=cpus;
+    if(n > KILO_INDEX_THREADS) n=KILO_INDEX_THREADS;
+    return n ? n : 1;
+}
+
+void editorLinesRun(struct linesWorker *w, int nw, void *(*fn)(void *)){
+    for(int k=1; k<nw; k++)
+        w[k].threaded = (pthread_create(&w[k].tid, NULL, fn, &w[k]) == 0);
+    fn(&w[0]);
+    for(int k=1; k<nw; k++){
+        if(w[k].threaded) pthread_join(w[k].tid, NULL);
+        else fn(&w[k]);
+    }
+}
+
+void editorLinesSplit(struct linesWorker *w, int nw){
+    for(int k=0; k<nw; k++){
+        memset(&w[k], 0, sizeof(w[k]));
+        w[k].from=(long long)E.numrows*k/nw;
+        w[k].to=(long long)E.numrows*(k+1)/nw;
+    }
+}
+
+int editorRowCompare(const erow *a, const erow *b){ //--bytewise, as sort does with LC_ALL=C
+    int n = a->size < b->size ? a->size : b->size;
+    int c = memcmp(a->chars, b->chars, n);
+    return c ? c : (a->size > b->size) - (a->size < b->size);
+}
+
+void editorLinesMerge(const int *a, int na, const int *b, int nb, int *out){
+    int i=0, j=0, k=0;
+    while(i<na && j<nb) //--ties take a first, the sort is stable
+        out[k++] = editorRowCompare(&E.row[b[j]], &E.row[a[i]]) < 0 ? b[j++] : a[i++];
+    while(i<na) out[k++]=a[i++];
+    while(j<nb) out[k++]=b[j++];
+}
+
+void *editorLinesSortRun(void *arg){
+    struct linesWorker *w=arg;
+    int n=w->to-w->from;
+    int *from=&w->src[w->from], *to=&w->tmp[w->from];
+    for(int width=1; width<n; width*=2){ //--bottom up, between the two buffers
+        for(int lo=0; lo<n; lo+=2*width){
+            int mid = lo+width < n ? lo+width : n;
+            int hi = lo+2*width < n ? lo+2*width : n;
+            editorLinesMerge(&from[lo], mid-lo, &from[mid], hi-mid, &to[lo]);
+        }
+        int *t=from;
+        from=to;
+        to=t;
+    }
+    if(from != &w->src[w->from]) memcpy(&w->src[w->from], from, sizeof(int)*n);
+    return NULL;
+}
+
+void *editorLinesMergeRun(void *arg){
+    struct linesWorker *w=arg;
+    editorLinesMerge(&w->src[w->lo], w->mid-w->lo, &w->src[w->mid], w->hi-w->mid, &w->tmp[w->lo]);
+    memcpy(&w->src[w->lo], &w->tmp[w->lo], sizeof(int)*(w->hi-w->lo));
+    return NULL;
+}
+
+/*
+ -->a merge sort of row numbers: every worker sorts its share, then the
+    sorted runs are merged pairwise, the pairs of a round in parallel
+ */
+void editorLinesSort(){
+    long long t=editorMonotonicMs();
+    int n=E.numrows;
+    int *src=malloc(sizeof(int)*(n+1)), *tmp=malloc(sizeof(int)*(n+1));
+    for(int j=0; j<n; j++) src[j]=j;
+    
+    int nw=editorLinesWorkers(n);
+    struct linesWorker w[KILO_INDEX_THREADS];
+    editorLinesSplit(w, nw);
+    for(int k=0; k<nw; k++){
+        w[k].src=src;
+        w[k].tmp=tmp;
+    }
+    editorLinesRun(w, nw, editorLinesSortRun);
+    
+    for(int step=1; step<nw; step*=2){
+        struct linesWorker m[KILO_INDEX_THREADS];
+        int nm=0;
+        for(int k=0; k+step<nw; k+=2*step){
+            memset(&m[nm], 0, sizeof(m[nm]));
+            m[nm].src=src;
+            m[nm].tmp=tmp;
+            m[nm].lo=w[k].from;
+            m[nm].mid=w[k+step].from;
+            m[nm].hi = k+2*step < nw ? w[k+2*step].from : n;
+            nm++;
+        }
+        editorLinesRun(m, nm, editorLinesMergeRun);
+    }
+    free(tmp);
+    
+    int moved=0;
+    for(int j=0; j<n; j++) moved += src[j]!=j;
+    if(moved){
+        rowOrder o={src, n, NULL, NULL, 0};
+        editorRowsApply(&o, NULL);
+    }
+    free(src);
+    editorSetStatusMessage("Sorted %d lines, %d moved (%lld ms)", n, moved, editorMonotonicMs()-t);
+}
+
+void *editorLinesHashRun(void *arg){
+    struct linesWorker *w=arg;
+    for(int j=w->from; j<w->to; j++) w->hash[j]=editorHashBlock(E.row[j].chars, E.row[j].size);
+    return NULL;
+}
+
+/*
+ -->keeps the first of every set of equal rows, wherever they are: rows are
+    hashed in parallel, then looked up in an open addressing table
+ */
+void editorLinesUnique(){
+    long long t=editorMonotonicMs();
+    int n=E.numrows;
+    uint64_t *hash=malloc(sizeof(uint64_t)*(n+1));
+    int nw=editorLinesWorkers(n);
+    struct linesWorker w[KILO_INDEX_THREADS];
+    editorLinesSplit(w, nw);
+    for(int k=0; k<nw; k++) w[k].hash=hash;
+    editorLinesRun(w, nw, editorLinesHashRun);
+    
+    int cap=16;
+    while(cap < 2*n) cap*=2;
+    int *table=malloc(sizeof(int)*cap);
+    for(int i=0; i<cap; i++) table[i]=-1;
+    int *src=malloc(sizeof(int)*(n+1));
+    int kept=0;
+    for(int j=0; j<n; j++){
+        size_t slot=hash[j] & (cap-1);
+        int dup=0;
+        while(table[slot] != -1){
+            int r=table[slot];
+            if(hash[r]==hash[j] && editorRowCompare(&E.row[r], &E.row[j])==0){
+                dup=1;
+                break;
+            }
+            slot=(slot+1) & (cap-1);
+        }
+        if(dup) continue;
+        table[slot]=j;
+        src[kept++]=j;
+    }
+    free(table);
+    free(hash);
+    
+    if(kept<n){
+        rowOrder o={src, kept, NULL, NULL, 0};
+        editorRowsApply(&o, NULL);
+    }
+    free(src);
+    editorSetStatusMessage("Removed %d duplicate lines of %d (%lld ms)", n-kept, n, editorMonotonicMs()-t);
+}
+
+void *editorLinesMatchRun(void *arg){
+    struct linesWorker *w=arg;
+    w->n=0;
+    for(int j=w->from; j<w->to; j++){
+        w->flag[j] = (strstr(E.row[j].chars, w->text) != NULL) == w->keep;
+        w->n += w->flag[j];
+    }
+    return NULL;
+}
+
+void *editorLinesCollectRun(void *arg){
+    struct linesWorker *w=arg;
+    int k=0;
+    for(int j=w->from; j<w->to; j++)
+        if(w->flag[j]) w->out[k++]=j;
+    return NULL;
+}
+
+/*
+ -->keeps the rows that contain text, or with keep 0 the rows that don't.
+    Workers test their share, then each writes its rows at its offset.
+ */
+void editorLinesFilter(const char *text, int keep){
+    long long t=editorMonotonicMs();
+    int n=E.numrows;
+    unsigned char *flag=malloc(n+1);
+    int *src=malloc(sizeof(int)*(n+1));
+    int nw=editorLinesWorkers(n);
+    struct linesWorker w[KILO_INDEX_THREADS];
+    editorLinesSplit(w, nw);
+    for(int k=0; k<nw; k++){
+        w[k].text=text;
+        w[k].keep=keep;
+        w[k].flag=flag;
+    }
+    editorLinesRun(w, nw, editorLinesMatchRun);
+    int kept=0;
+    for(int k=0; k<nw; k++){
+        w[k].out=&src[kept];
+        kept+=w[k].n;
+    }
+    editorLinesRun(w, nw, editorLinesCollectRun);
+    free(flag);
+    
+    if(kept<n){
+        rowOrder o={src, kept, NULL, NULL, 0};
+        editorRowsApply(&o, NULL);
+    }
+    free(src);
+    editorSetStatusMessage("Kept %d of %d lines (%lld ms)", kept, n, editorMonotonicMs()-t);
+}
+
+void editorLinesCommand(char *cmd){
+    if(!strcmp(cmd, "sort")) editorLinesSort();
+    else if(!strcmp(cmd, "uniq") || !strcmp(cmd, "unique")) editorLinesUnique();
+    else if(!strncmp(cmd, "keep ", 5) && cmd[5]) editorLinesFilter(&cmd[5], 1);
+    else if(!strncmp(cmd, "drop ", 5) && cmd[5]) editorLinesFilter(&cmd[5], 0);
+    else editorSetStatusMessage("Unknown line command: %s", cmd);
+}
+
+void editorLines(){
+    char *cmd=editorPrompt("Lines (sort, uniq, keep TEXT, drop TEXT): %s", NULL);
+    if(cmd==NULL) return;
+    editorLinesCommand(cmd);
+    free(cmd);
+}
+
+/* line index */
+
+typedef struct lineIndex{
+    uint64_t *start; //--offset of the first byte of every line
+    int n;
+}lineIndex;
+
+struct indexWorker{
+    const char *map;
+    size_t from, to; //--bytes this worker covers, whole blocks
+    uint64_t *start; //--line starts found in [from, to)
+    int n, cap;
+    const lineIndex *li;
+    const unsigned char *states; //--comment state bitmap of all lines, or NULL
+    const struct bracketSum *brace; //--bracket sums of all lines, with states
+    int base; //--row the first indexed line becomes
+    int first, last; //--lines this worker materializes
+    pthread_t tid;
+    int threaded;
+};
+
+uint64_t editorHashBlock(const char *p, size_t len){
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+    uint64_t w;
+    size_t i=0;
+    for(; i+8<=len; i+=8){ //--a word at a time
+        memcpy(&w, &p[i], 8);
+        h = (h ^ (w * 0xbf58476d1ce4e5b9ULL)) * 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+    }
+    for(; i<len; i++)
+        h = (h ^ (unsigned char)p[i]) * 0x100000001b3ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void *editorIndexScan(void *arg){
+    struct indexWorker *w = arg;
+    for(size_t b=w->from; b<w->to; b+=KILO_INDEX_BLOCK){
+        size_t e = (w->to-b > KILO_INDEX_BLOCK) ? b+KILO_INDEX_BLOCK : w->to;
+        const char *p = w->map + b;
+        const char *end = w->map + e;
+        const char *nl;
+        //--memchr is the vectorized newline search of the libc
+        while(p < end && (nl = memchr(p, '\n', end-p)) != NULL){
+            if(w->n == w->cap){
+                w->cap = w->cap ? w->cap*2 : 4096;
+                w->start = realloc(w->start, sizeof(uint64_t)*w->cap);
+            }
+            w->start[w->n++] = nl+1 - w->map;
+            p = nl+1;
+        }
+    }
+    return NULL;
+}
+
+void *editorIndexMaterialize(void *arg){
+    struct indexWorker *w = arg;
+    const lineIndex *li = w->li;
+    for(int at=w->first; at<w->last; at++){
+        size_t off = li->start[at];
+        size_t end = (at+1 < li->n) ? li->start[at+1] : w->to;
+        size_t len = end-off;
+        while(len>0 && (w->map[off+len-1]=='\n' || w->map[off+len-1]=='\r'))
+            len--;
+        
+        erow *row = &E.row[w->base+at];
+        row->idx=w->base+at;
+        row->size=len;
+        row->chars=malloc(len+1);
+        editorMemAdd(MEM_CHARS, len+1);
+        memcpy(row->chars, &w->map[off], len);
+        row->chars[len]='\0';
+        row->rsize=0;
+        row->render=NULL;
+        row->hl=NULL;
+        row->hl_open_comment=0;
+        memset(&row->brace, 0, sizeof(struct bracketSum));
+        row->hidden=0;
+        if(!w->states){
+            editorUpdateRender(row);
+            continue;
+        }
+        //--from a cache: what the rest of the editor needs of every row is known,
+        //render and hl are built like dropped ones when the row is looked at
+        row->rsize=editorRowCxToRx(row, len);
+        row->hl_open_comment=w->states[at/8] >> (at%8) & 1;
+        row->brace=w->brace[at];
+    }
+    return NULL;
+}
+
+int editorIndexWorkers(size_t size){
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n = size / KILO_INDEX_BLOCK; //--small files are done inline
+    if(cpus < 1) cpus=1;
+    if(n > (size_t)cpus) n=cpus;
+    if(n > KILO_INDEX_THREADS) n=KILO_INDEX_THREADS;
+    return n ? n : 1;
+}
+
+void editorIndexRun(struct indexWorker *w, int nw, void *(*fn)(void *)){
+    //--worker 0 runs on the calling thread, it would only wait otherwise
+    for(int k=1; k<nw; k++)
+        w[k].threaded = (pthread_create(&w[k].tid, NULL, fn, &w[k]) == 0);
+    fn(&w[0]);
+    for(int k=1; k<nw; k++){
+        if(w[k].threaded) pthread_join(w[k].tid, NULL);
+        else fn(&w[k]); //--no thread to spare, do it here
+    }
+}
+
+/*
+ -->hands every worker a run of whole blocks
+ */
+int editorIndexSplit(struct indexWorker *w, const char *map, size_t size){
+    int nw = editorIndexWorkers(size);
+    size_t nb = (size + KILO_INDEX_BLOCK-1) / KILO_INDEX_BLOCK;
+    for(int k=0; k<nw; k++){
+        memset(&w[k], 0, sizeof(w[k]));
+        w[k].map=map;
+        w[k].from= nb*k/nw * KILO_INDEX_BLOCK;
+        w[k].to= (k==nw-1) ? size : nb*(k+1)/nw * KILO_INDEX_BLOCK;
+    }
+    return nw;
+}
+
+/*
+ -->splits the mapped file into one chunk per worker, every worker collects
+    the line starts of its chunk and the per chunk results are stitched
+    together at their prefix sums.
+ */
+void editorIndexBuild(lineIndex *li, const char *map, size_t size){
+    li->start=NULL;
+    li->n=0;
+    if(size==0) return;
+    
+    struct indexWorker w[KILO_INDEX_THREADS];
+    int nw = editorIndexSplit(w, map, size);
+    editorIndexRun(w, nw, editorIndexScan);
+    
+    int total=1; //--line 0 starts at offset 0
+    for(int k=0; k<nw; k++) total += w[k].n;
+    if(w[nw-1].n && w[nw-1].start[w[nw-1].n-1]==size) total--; //--final newline ends the last line
+    
+    li->start = malloc(sizeof(uint64_t)*total);
+    li->start[0]=0;
+    int pos=1;
+    for(int k=0; k<nw; k++){
+        int n = (pos+w[k].n > total) ? total-pos : w[k].n;
+        memcpy(&li->start[pos], w[k].start, sizeof(uint64_t)*n);
+        pos+=n;
+        free(w[k].start);
+    }
+    li->n=total;
+}
+
+/*
+ -->appends the indexed lines as rows, in parallel for the chars and render
+    arrays. Without the comment states and bracket sums of a cache (those
+    only describe a whole file), highlighting runs afterwards in file order
+    because every row depends on the comment state of the one above it.
+    With them, render and hl are left to the rows that get looked at.
+ */
+void editorIndexLoadRows(const lineIndex *li, const char *map, size_t size,
+                         const unsigned char *states, const struct bracketSum *brace){
+    if(li->n==0) return;
+    E.row = realloc(E.row, sizeof(erow)*(E.numrows+li->n));
+    editorMemAdd(MEM_ROWS, (long long)sizeof(erow)*(E.numrows+li->n) - E.rowbytes);
+    E.rowbytes = sizeof(erow)*(E.numrows+li->n);
+    
+    int nw = editorIndexWorkers(size);
+    struct indexWorker w[KILO_INDEX_THREADS];
+    for(int k=0; k<nw; k++){
+        memset(&w[k], 0, sizeof(w[k]));
+        w[k].map=map;
+        w[k].to=size;
+        w[k].li=li;
+        w[k].states= E.numrows==0 ? states : NULL;
+        w[k].brace=brace;
+        w[k].base=E.numrows;
+        w[k].first=(long long)li->n*k/nw;
+        w[k].last=(long long)li->n*(k+1)/nw;
+    }
+    editorIndexRun(w, nw, editorIndexMaterialize);
+    
+    int base=E.numrows;
+    E.numrows+=li->n;
+    if(w[0].states) return;
+    for(int j=base; j<E.numrows; j++)
+        editorHighlightRow(&E.row[j]);
+}
+
+/* index cache */
+
+/*
+ -->a <file>.kindex sidecar holds the line index, the bracket sums and the
+    comment state of every line of a big file, laid out to be mapped and
+    used in place: this header, the path padded to 8 bytes, the line starts
+    as native uint64, the sums as native struct bracketSum, then one bit
+    per line
+ */
+struct indexCacheHeader{
+    char magic[8];
+    uint64_t size;
+    int64_t mtime, mtime_ns;
+    uint64_t dev, ino; //--a file replaced by another one is another file
+    uint64_t hash; //--of KILO_CACHE_SAMPLES pieces, catches what size and mtime miss
+    uint64_t nlines;
+    uint64_t syntax; //--editorSyntaxHash of the definition states and sums were derived with
+    uint64_t pathlen;
+};
+
+typedef struct indexCache{
+    char *map;
+    size_t len;
+    lineIndex li;
+    const struct bracketSum *brace;
+    const unsigned char *states;
+}indexCache;
+
+char *editorCachePath(const char *filename){
+    char *path = malloc(strlen(filename) + sizeof(KILO_CACHE_SUFFIX));
+    strcpy(path, filename);
+    strcat(path, KILO_CACHE_SUFFIX);
+    return path;
+}
+
+void editorCacheFillHeader(struct indexCacheHeader *h, const struct stat *st){
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, KILO_CACHE_MAGIC, 8);
+    h->size=st->st_size;
+    h->mtime=st->st_mtim.tv_sec;
+    h->mtime_ns=st->st_mtim.tv_nsec;
+    h->dev=st->st_dev;
+    h->ino=st->st_ino;
+    h->syntax=editorSyntaxHash(E.syntax);
+    h->pathlen=strlen(E.filename);
+}
+
+/*
+ -->a hash of pieces spread evenly over the file: an edit that kept size and
+    mtime, a touch -r after it say, is caught when it changes one of them
+ */
+uint64_t editorCacheSample(const char *map, size_t size){
+    uint64_t h[KILO_CACHE_SAMPLES];
+    size_t len = size < KILO_CACHE_SAMPLE ? size : KILO_CACHE_SAMPLE;
+    for(int k=0; k<KILO_CACHE_SAMPLES; k++)
+        h[k]=editorHashBlock(&map[(size-len)*k/(KILO_CACHE_SAMPLES-1)], len);
+    return editorHashBlock((const char *)h, sizeof(h));
+}
+
+/*
+ -->maps the cache of an unchanged file, which is told by its stat and a
+    sampled hash; nothing else of the file is read. Returns -1 if there is
+    no valid cache.
+ */
+int editorCacheLoad(indexCache *c, const struct stat *st, const char *map){
+    if(st->st_size < KILO_CACHE_MIN_SIZE) return -1;
+    
+    char *path = editorCachePath(E.filename);
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if(fd == -1) return -1;
+    
+    struct stat cst;
+    c->map = MAP_FAILED;
+    if(fstat(fd, &cst) != -1 && cst.st_size >= (off_t)sizeof(struct indexCacheHeader)){
+        c->len = cst.st_size;
+        c->map = mmap(NULL, c->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if(c->map == MAP_FAILED) return -1;
+    
+    struct indexCacheHeader want;
+    editorCacheFillHeader(&want, st);
+    const struct indexCacheHeader *h = (const struct indexCacheHeader *)c->map;
+    size_t off = sizeof(*h) + ((want.pathlen+7) & ~7ULL);
+    if(memcmp(h->magic, want.magic, 8) || h->size!=want.size || h->mtime!=want.mtime ||
+       h->mtime_ns!=want.mtime_ns || h->dev!=want.dev || h->ino!=want.ino ||
+       h->syntax!=want.syntax || h->pathlen!=want.pathlen ||
+       h->nlines > INT32_MAX ||
+       c->len != off + h->nlines*(8+sizeof(struct bracketSum)) + (h->nlines+7)/8 ||
+       memcmp(c->map+sizeof(*h), E.filename, want.pathlen) ||
+       editorCacheSample(map, st->st_size) != h->hash){
+        munmap(c->map, c->len);
+        return -1;
+    }
+    
+    c->li.start = (uint64_t *)(c->map+off);
+    c->li.n = h->nlines;
+    c->brace = (const struct bracketSum *)(c->map + off + h->nlines*8);
+    c->states = (const unsigned char *)(c->map + off + h->nlines*(8+sizeof(struct bracketSum)));
+    return 0;
+}
+
+void editorCacheRelease(indexCache *c){
+    munmap(c->map, c->len);
+}
+
+void editorCacheSave(const lineIndex *li, const struct stat *st, const char *map){
+    struct indexCacheHeader h;
+    editorCacheFillHeader(&h, st);
+    h.hash=editorCacheSample(map, st->st_size);
+    h.nlines=li->n;
+    
+    size_t nbits=(li->n+7)/8;
+    unsigned char *states = calloc(nbits ? nbits : 1, 1);
+    struct bracketSum *brace = calloc(li->n ? li->n : 1, sizeof(struct bracketSum));
+    for(int j=0; j<E.numrows && j<li->n; j++){
+        if(E.row[j].hl_open_comment) states[j/8] |= 1<<(j%8);
+        brace[j]=E.row[j].brace;
+    }
+    
+    char *path = editorCachePath(E.filename);
+    char *tmp = malloc(strlen(path)+5);
+    strcpy(tmp, path);
+    strcat(tmp, ".tmp");
+    
+    //--written aside and renamed, a reader never maps half a cache
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd != -1){
+        char pad[8]={0};
+        int ok = write(fd, &h, sizeof(h))==sizeof(h) &&
+                 write(fd, E.filename, h.pathlen)==(ssize_t)h.pathlen &&
+                 write(fd, pad, (8-h.pathlen%8)%8)==(ssize_t)((8-h.pathlen%8)%8) &&
+                 write(fd, li->start, sizeof(uint64_t)*li->n)==(ssize_t)(sizeof(uint64_t)*li->n) &&
+                 write(fd, brace, sizeof(struct bracketSum)*li->n)==(ssize_t)(sizeof(struct bracketSum)*li->n) &&
+                 write(fd, states, nbits)==(ssize_t)nbits;
+        close(fd);
+        if(!ok || rename(tmp, path) == -1) unlink(tmp);
+    }
+    free(brace);
+    free(states);
+    free(tmp);
+    free(path);
+}
+
+/* gzip */
+
+/*
+ -->a thread inflates the mapped file and hands whole lines over in chunks
+    through a small ring, so rows are built from one chunk while the next
+    one is being decompressed
+ */
+struct gzipReader{
+    const char *map;
+    size_t size;
+    char *slot[KILO_GZIP_SLOTS];
+    size_t len[KILO_GZIP_SLOTS];
+    int head, count; //--next chunk to take, chunks ready
+    int done; //--the inflating thread has finished
+    int error; //--the stream is corrupt or cut short
+    int stop; //--the reader gave up, the thread should too
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t tid;
+};
+
+int editorGzipDetect(const char *map, size_t size){
+    return size>=2 && (unsigned char)map[0]==0x1f && (unsigned char)map[1]==0x8b;
+}
+
+int editorGzipPut(struct gzipReader *r, char *buf, size_t len){
+    pthread_mutex_lock(&r->lock);
+    while(r->count==KILO_GZIP_SLOTS && !r->stop) pthread_cond_wait(&r->cond, &r->lock);
+    int stop=r->stop;
+    if(!stop){
+        int at=(r->head+r->count)%KILO_GZIP_SLOTS;
+        r->slot[at]=buf;
+        r->len[at]=len;
+        r->count++;
+        pthread_cond_broadcast(&r->cond);
+    }
+    pthread_mutex_unlock(&r->lock);
+    if(stop) free(buf);
+    return stop ? -1 : 0;
+}
+
+void *editorGzipInflate(void *arg){
+    struct gzipReader *r=arg;
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    int ret = inflateInit2(&z, 15+32)==Z_OK ? Z_OK : Z_MEM_ERROR; //--+32: gzip or zlib header
+    size_t left=r->size;
+    z.next_in=(Bytef *)r->map;
+    size_t cap=KILO_GZIP_CHUNK, len=0;
+    char *buf=malloc(cap);
+    
+    while(ret==Z_OK){
+        if(z.avail_in==0){
+            if(left==0) break; //--cut short
+            z.avail_in = left>UINT_MAX ? UINT_MAX : left;
+            left-=z.avail_in;
+        }
+        if(len==cap){ //--full: hand it over up to the last newline, the rest starts the next one
+            size_t cut=len;
+            while(cut>0 && buf[cut-1]!='\n') cut--;
+            if(cut==0){ //--a line longer than a chunk
+                cap*=2;
+                buf=realloc(buf, cap);
+            }else{
+                size_t ncap=KILO_GZIP_CHUNK;
+                while(ncap <= len-cut) ncap*=2;
+                char *next=malloc(ncap);
+                memcpy(next, &buf[cut], len-cut);
+                if(editorGzipPut(r, buf, cut) == -1){
+                    buf=next;
+                    len=0;
+                    break;
+                }
+                buf=next;
+                len-=cut;
+                cap=ncap;
+            }
+        }
+        size_t room = cap-len>UINT_MAX ? UINT_MAX : cap-len;
+        z.next_out=(Bytef *)&buf[len];
+        z.avail_out=room;
+        ret=inflate(&z, Z_NO_FLUSH);
+        len+=room-z.avail_out;
+        if(ret==Z_STREAM_END && (z.avail_in || left)) //--another member follows, as cat a.gz b.gz makes
+            ret=inflateReset(&z);
+    }
+    inflateEnd(&z);
+    
+    if(len) editorGzipPut(r, buf, len); //--the last line may have no newline
+    else free(buf);
+    pthread_mutex_lock(&r->lock);
+    r->error = (ret!=Z_STREAM_END);
+    r->done=1;
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+void editorGzipStart(struct gzipReader *r, const char *map, size_t size){
+    memset(r, 0, sizeof(*r));
+    r->map=map;
+    r->size=size;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cond, NULL);
+    if(pthread_create(&r->tid, NULL, editorGzipInflate, r) != 0) die("pthread_create");
+}
+
+/*
+ -->the next chunk of whole lines, to be freed by the caller, or NULL at
+    the end of the stream
+ */
+char *editorGzipNext(struct gzipReader *r, size_t *len){
+    pthread_mutex_lock(&r->lock);
+    while(r->count==0 && !r->done) pthread_cond_wait(&r->cond, &r->lock);
+    char *buf=NULL;
+    if(r->count){
+        buf=r->slot[r->head];
+        *len=r->len[r->head];
+        r->head=(r->head+1)%KILO_GZIP_SLOTS;
+        r->count--;
+        pthread_cond_broadcast(&r->cond);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return buf;
+}
+
+int editorGzipFinish(struct gzipReader *r){
+    pthread_mutex_lock(&r->lock);
+    r->stop=1;
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+    pthread_join(r->tid, NULL);
+    for(; r->count; r->count--, r->head=(r->head+1)%KILO_GZIP_SLOTS)
+        free(r->slot[r->head]);
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->cond);
+    return r->error ? -1 : 0;
+}
+
+/*
+ -->appends the lines of a gzip file as rows, chunk by chunk through the
+    parallel line index. Returns -1 if the file is corrupt or truncated,
+    with the rows that could be read loaded all the same.
+ */
+int editorGzipLoad(const char *map, size_t size){
+    struct gzipReader r;
+    editorGzipStart(&r, map, size);
+    char *buf;
+    size_t len;
+    while((buf = editorGzipNext(&r, &len)) != NULL){
+        lineIndex li;
+        editorIndexBuild(&li, buf, len);
+        editorIndexLoadRows(&li, buf, len, NULL, NULL);
+        free(li.start);
+        free(buf);
+    }
+    return editorGzipFinish(&r);
+}
+
+int editorGzipWrite(int fd, z_stream *z, int flush, char *out, long long *written){
+    int ret;
+    do{
+        z->next_out=(Bytef *)out;
+        z->avail_out=KILO_GZIP_CHUNK;
+        ret=deflate(z, flush);
+        size_t n=KILO_GZIP_CHUNK-z->avail_out;
+        for(size_t done=0; done<n; ){ //--a short write is retried, the next one tells why
+            ssize_t w=write(fd, out+done, n-done);
+            if(w==-1) return -1;
+            done+=w;
+        }
+        *written+=n;
+    }while(z->avail_out==0 || (flush==Z_FINISH && ret!=Z_STREAM_END));
+    return ret==Z_STREAM_ERROR ? -1 : 0;
+}
+
+/*
+ -->compresses the rows into fd as they are gathered, without the whole
+    file in memory. Returns the compressed size, -1 on a write error.
+ */
+long long editorGzipSave(int fd, long long *plain){
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if(deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1; //--+16: a gzip header and trailer
+    char *in=malloc(KILO_GZIP_CHUNK), *out=malloc(KILO_GZIP_CHUNK);
+    long long written=0;
+    size_t len=0;
+    int ok=0;
+    *plain=0;
+    for(int j=0; j<E.numrows && ok==0; j++){
+        erow *row=&E.row[j];
+        for(int at=0; at<=row->size && ok==0; ){ //--at==size is the newline
+            size_t n = (size_t)(row->size-at) < KILO_GZIP_CHUNK-len ? (size_t)(row->size-at) : KILO_GZIP_CHUNK-len;
+            memcpy(&in[len], &row->chars[at], n);
+            len+=n;
+            at+=n;
+            if(at==row->size && len<KILO_GZIP_CHUNK){
+                in[len++]='\n';
+                at++;
+            }
+            if(len==KILO_GZIP_CHUNK){
+                z.next_in=(Bytef *)in;
+                z.avail_in=len;
+                ok=editorGzipWrite(fd, &z, Z_NO_FLUSH, out, &written);
+                *plain+=len;
+                len=0;
+            }
+        }
+    }
+    z.next_in=(Bytef *)in;
+    z.avail_in=len;
+    *plain+=len;
+    if(ok==0) ok=editorGzipWrite(fd, &z, Z_FINISH, out, &written);
+    deflateEnd(&z);
+    free(in);
+    free(out);
+    return ok==0 ? written : -1;
+}
+
+/*file i/o*/
+
+char *editorRowtoString(int *buflen){
+    int totlen=0;
+    int j;
+    for(j=0; j<E.numrows;j++)
+        totlen += E.row[j].size +1;
+    *buflen = totlen;
+    
+    char *buf = malloc(totlen);
+    char *p=buf;
+    for(j=0;j<E.numrows; j++){
+        memcpy(p, E.row[j].chars, E.row[j].size);
+        p+=E.row[j].size;
+        *p='\n';
+        p++;
+    }
+    
+    return buf;
+}
+
+int editorJournalGetVarint(const char *buf, int len, int *pos, unsigned long long *v){
+    *v=0;
+    int shift=0;
+    while(*pos < len && shift < 64){
+        unsigned char b = buf[(*pos)++];
+        *v |= (unsigned long long)(b & 0x7f) << shift;
+        if(!(b & 0x80)) return 0;
+        shift += 7;
+    }
+    return -1; //--ran off the end: torn record
+}
+
+/*
+ -->a JOURNAL_ROW_ORDER record of n rows, -1 if it is torn or doesn't fit
+    the rows there are
+ */
+int editorJournalReplayOrder(const char *buf, int len, int *pos, unsigned long long n){
+    if(n > (unsigned long long)(len-*pos)) return -1; //--at least a byte a row
+    rowOrder o={malloc(sizeof(int)*(n+1)), n, malloc(sizeof(char *)*(n+1)), malloc(sizeof(int)*(n+1)), 0};
+    int ok=1;
+    for(unsigned long long j=0; j<n && ok; j++){
+        unsigned long long v, tl;
+        if(editorJournalGetVarint(buf, len, pos, &v) == -1){
+            ok=0;
+        }else if(v){
+            o.src[j]=v-1;
+            if(v-1 >= (unsigned long long)E.numrows) ok=0;
+        }else if(editorJournalGetVarint(buf, len, pos, &tl) == -1 || tl > (unsigned long long)(len-*pos)){
+            ok=0;
+        }else{
+            o.src[j]=-1-o.ntext;
+            o.len[o.ntext]=tl;
+            o.text[o.ntext]=malloc(tl+1);
+            memcpy(o.text[o.ntext], &buf[*pos], tl);
+            o.text[o.ntext++][tl]='\0';
+            *pos+=tl;
+        }
+    }
+    if(ok) editorRowsApply(&o, NULL);
+    for(int k=0; k<o.ntext; k++) free(o.text[k]);
+    free(o.src);
+    free(o.text);
+    free(o.len);
+    return ok ? 0 : -1;
+}
+
+/*
+ -->applies the journal left behind by a crashed session on top of the
+    freshly loaded rows. The work done is proportional to the number of
+    logged edits, the file itself is never rewritten. Returns the number
+    of edits recovered, 0 if there was no (usable) journal.
+ */
+int editorJournalReplay(){
+    char *path = editorJournalPath(E.filename);
+    int fd = open(path, O_RDWR);
+    if(fd == -1){
+        free(path);
+        return 0;
+    }
+    
+    struct stat jst, st;
+    char *buf=NULL;
+    int len=0;
+    if(fstat(fd, &jst) != -1 && jst.st_size > 0){
+        len = jst.st_size;
+        buf = malloc(len);
+        if(read(fd, buf, len) != len) len=0;
+    }
+    if(stat(E.filename, &st) == -1){
+        st.st_size=0;
+        st.st_mtime=0;
+    }
+    
+    int pos=4;
+    unsigned long long size, mtime;
+    if(len < 4 || memcmp(buf, KILO_JOURNAL_MAGIC, 4) ||
+       editorJournalGetVarint(buf, len, &pos, &size) == -1 ||
+       editorJournalGetVarint(buf, len, &pos, &mtime) == -1 ||
+       size != (unsigned long long)st.st_size || mtime != (unsigned long long)st.st_mtime){
+        //--written against another version of the file, useless now
+        free(buf);
+        close(fd);
+        unlink(path);
+        free(path);
+        return 0;
+    }
+    free(path);
+    
+    int count=0;
+    int valid=pos; //--end of the last complete record
+    E.journal.suspended=1;
+    while(pos < len){
+        int op = (unsigned char)buf[pos++];
+        unsigned long long row, at, n;
+        if(editorJournalGetVarint(buf, len, &pos, &row) == -1 ||
+           editorJournalGetVarint(buf, len, &pos, &at) == -1 ||
+           editorJournalGetVarint(buf, len, &pos, &n) == -1) break;
+        if(op == JOURNAL_ROW_ORDER){
+            if(editorJournalReplayOrder(buf, len, &pos, n) == -1) break;
+            valid = pos;
+            count++;
+            continue;
+        }
+        char *s = &buf[pos];
+        if(op == JOURNAL_ROW_INSERT || op == JOURNAL_TEXT_INSERT){
+            if(n > (unsigned long long)(len-pos)) break;
+            pos += n;
+        }
+        
+        if(op == JOURNAL_ROW_INSERT) editorInsertRow(row, s, n);
+        else if(row < (unsigned long long)E.numrows){
+            erow *r = &E.row[row];
+            switch(op){
+                case JOURNAL_ROW_DEL: editorDelRow(row); break;
+                case JOURNAL_TEXT_INSERT: editorRowInsertString(r, at, s, n); break;
+                case JOURNAL_TEXT_DEL: editorRowDelString(r, at, n); break;
+            }
+        }
+        valid = pos;
+        count++;
+    }
+    E.journal.suspended=0;
+    free(buf);
+    
+    //--keep appending to the same journal, minus a torn tail record
+    if(ftruncate(fd, valid) == -1 || lseek(fd, valid, SEEK_SET) == -1){
+        close(fd);
+        return count;
+    }
+    E.journal.fd = fd;
+    E.journal.last_sync = editorMonotonicMs();
+    return count;
+}
+
+void editorOpen(char *filename){
+    free(E.filename);
+    E.filename= strdup(filename);
+    
+    editorSelectSyntaxHighlight();
+    
+    FILE *fp= fopen(filename, "r");
+    if(!fp) die("fopen");
+    
+    struct stat st;
+    char *map= MAP_FAILED;
+    if(fstat(fileno(fp), &st)!=-1 && S_ISREG(st.st_mode) && st.st_size>0)
+        map= mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    
+    E.journal.suspended=1; //--the file itself is not an edit
+    E.undo.suspended=1;
+    E.gzip = map!=MAP_FAILED && editorGzipDetect(map, st.st_size);
+    if(E.gzip){ //--no index cache or follow mode, both work on the bytes on disk
+        if(editorGzipLoad(map, st.st_size) == -1)
+            editorSetStatusMessage("%s is corrupt or truncated, %d lines read", filename, E.numrows);
+        munmap(map, st.st_size);
+    }else if(map != MAP_FAILED && editorHexDetect(map, st.st_size)){
+        editorHexOpen(map, st.st_size); //--keeps the mapping, nothing is read ahead
+    }else if(map != MAP_FAILED){
+        indexCache cache;
+        if(editorCacheLoad(&cache, &st, map) == 0){
+            //--unchanged since it was last opened: no scan, rows highlight when shown
+            editorIndexLoadRows(&cache.li, map, st.st_size, cache.states, cache.brace);
+            editorCacheRelease(&cache);
+        }else{
+            lineIndex li;
+            editorIndexBuild(&li, map, st.st_size);
+            editorIndexLoadRows(&li, map, st.st_size, NULL, NULL);
+            if(st.st_size >= KILO_CACHE_MIN_SIZE) editorCacheSave(&li, &st, map);
+            free(li.start);
+        }
+        E.follow.offset=st.st_size;
+        E.follow.partial=(map[st.st_size-1]!='\n');
+        munmap(map, st.st_size);
+    }else{ //--pipes and the like can't be mapped
+        char *line= NULL;
+        size_t linecap=0;
+        ssize_t linelen;
+        while((linelen = getline(&line, &linecap, fp))!= -1){
+            while(linelen>0 && (line[linelen-1]=='\n' || line[linelen-1]=='\r'))
+                linelen--;
+            editorInsertRow(E.numrows, line, linelen);
+        }
+        free(line);
+    }
+    E.journal.suspended=0;
+    E.undo.suspended=0;
+    
+    fclose(fp);
+    E.dirty=0;
+    editorDiffReset(); //--what the journal replays differs from the disk
+    if(E.hex.on) return; //--there are no rows to replay edits on
+    
+    int recovered = editorJournalReplay();
+    if(recovered)
+        editorSetStatusMessage("Recovered %d edits from %s%s", recovered,
+                               E.filename, KILO_JOURNAL_SUFFIX);
+}
+
+void editorSave(){
+    if(E.hex.on){
+        editorSetStatusMessage("The hex view is read only");
+        return;
+    }
+    if(E.filename==NULL){
+        E.filename=editorPrompt("Save as: %s (ESC to cancel)", NULL);
+        if(E.filename==NULL){
+            editorSetStatusMessage("Save aborted");
+            return;
+        }
+        E.gzip=(strlen(E.filename) > strlen(KILO_GZIP_SUFFIX) &&
+                !strcmp(E.filename+strlen(E.filename)-strlen(KILO_GZIP_SUFFIX), KILO_GZIP_SUFFIX));
+        editorSelectSyntaxHighlight();
+    }
+    
+    if(E.gzip){
+        /*
+         -->a stream cut short can't be decompressed at all, so the file is
+            written aside, synced and renamed over the old one
+         */
+        struct stat st;
+        mode_t mode;
+        if(stat(E.filename, &st)==-1){ //--a new file gets what open would have given it
+            mode_t mask=umask(0);
+            umask(mask);
+            mode = 0644 & ~mask;
+        }else{
+            mode = st.st_mode & 07777;
+        }
+        char *tmp=malloc(strlen(E.filename)+8);
+        sprintf(tmp, "%s.XXXXXX", E.filename); //--a name no file has, next to it for the rename
+        int fd= mkstemp(tmp);
+        if(fd!=-1 && fchmod(fd, mode)==-1){
+            close(fd);
+            unlink(tmp);
+            fd=-1;
+        }
+        long long plain, len = fd!=-1 ? editorGzipSave(fd, &plain) : -1;
+        int ok = len!=-1 && fsync(fd)!=-1;
+        int err = errno;
+        if(fd!=-1 && close(fd)==-1 && ok){
+            ok=0;
+            err=errno;
+        }
+        if(ok && rename(tmp, E.filename)==-1){
+            ok=0;
+            err=errno;
+        }
+        if(!ok && fd!=-1) unlink(tmp);
+        free(tmp);
+        if(ok){
+            E.dirty=0;
+            editorJournalDiscard();
+            editorDiffReset();
+            editorSetStatusMessage("%lld bytes written to disk, %lld compressed", plain, len);
+        }else{
+            editorSetStatusMessage("Can't save! I/O error: %s", strerror(err));
+        }
+        return;
+    }
+    
+    int len;
+    char *buf=editorRowtoString(&len);
+    
+    int fd= open(E.filename, O_RDWR | O_CREAT, 0644);
+    if(fd!=-1){
+        if((ftruncate(fd, len))!=-1){
+            if((write(fd, buf, len))==len){
+                close(fd);
+                free(buf);
+                E.dirty=0;
+                editorJournalDiscard(); //--everything is on disk now
+                editorDiffReset();
+                E.follow.offset=len;
+                E.follow.partial=0;
+                editorSetStatusMessage("%d bytes written to disk", len);
+                return;
+            }
+        }
+        close(fd);
+    }
+    free(buf);
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+}
+
+/*
+ -->drops the buffer and everything hanging off it. A journal is kept on
+    disk, the edits it holds were never saved.
+ */
+void editorCloseFile(){
+    editorFollowStop();
+    editorUndoClear();
+    
+    editorJournalSync();
+    if(E.journal.fd != -1){
+        if(E.journal.unsynced) fdatasync(E.journal.fd);
+        close(E.journal.fd);
+        E.journal.fd=-1;
+        E.journal.unsynced=0;
+    }
+    
+    for(int j=0; j<E.numrows; j++)
+        editorFreeRow(&E.row[j]);
+    free(E.row);
+    editorMemAdd(MEM_ROWS, -E.rowbytes);
+    editorMemAdd(MEM_ROWS, -(long long)sizeof(int)*E.view.n);
+    free(E.view.tree);
+    free(E.view.folds);
+    E.view.tree=NULL;
+    E.view.folds=NULL;
+    E.view.n=E.view.valid=E.view.segoff=0;
+    E.view.nfolds=E.view.capfolds=0;
+    editorMemAdd(MEM_ROWS, -(long long)sizeof(struct bracketSum)*2*E.brackets.cap);
+    free(E.brackets.tree);
+    memset(&E.brackets, 0, sizeof(E.brackets));
+    editorDiffFree();
+    E.diff.on=0;
+    editorHexClose();
+    E.locations=0;
+    E.rowbytes=0;
+    E.row=NULL;
+    E.numrows=0;
+    free(E.filename);
+    E.filename=NULL;
+    E.gzip=0;
+    E.syntax=NULL;
+    E.cx=E.cy=E.rx=0;
+    E.rowoff=E.coloff=0;
+    E.dirty=0;
+}
+
+/* follow */
+
+/*
+ -->adds bytes that were appended to the file. They are not edits: neither
+    the journal nor the undo log sees them and the buffer stays clean.
+ */
+void editorFollowAppend(const char *buf, size_t len){
+    int at_end = (E.cy >= E.numrows-1);
+    int dirty = E.dirty;
+    E.journal.suspended=1;
+    E.undo.suspended=1;
+    
+    if(E.follow.partial && E.numrows>0){ //--finish the unterminated last row first
+        const char *nl = memchr(buf, '\n', len);
+        size_t n = nl ? (size_t)(nl-buf) : len;
+        size_t keep = n;
+        while(keep>0 && buf[keep-1]=='\r') keep--;
+        editorRowAppendString(&E.row[E.numrows-1], (char *)buf, keep);
+        if(nl) n++;
+        buf+=n;
+        len-=n;
+        E.follow.partial = (nl==NULL);
+    }
+    if(len){
+        lineIndex li;
+        editorIndexBuild(&li, buf, len);
+        editorIndexLoadRows(&li, buf, len, NULL, NULL); //--one realloc for the whole batch
+        free(li.start);
+        E.follow.partial = (buf[len-1]!='\n');
+    }
+    
+    E.journal.suspended=0;
+    E.undo.suspended=0;
+    E.dirty=dirty;
+    if(at_end && E.numrows>0){
+        E.cy=E.numrows-1;
+        E.cx=0;
+    }
+}
+
+/*
+ -->checks the followed file once per idle tick of editorReadKey. With
+    inotify that costs a single read() that fails with EAGAIN until the
+    file is written to; elsewhere it falls back to a stat of the file.
+    Returns 1 if the buffer changed.
+ */
+int editorFollowPoll(){
+    struct editorFollow *f=&E.follow;
+    if(!f->on) return 0;
+    
+    if(f->ifd!=-1 && !f->pending){
+#ifdef __linux__
+        char ev[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t n = read(f->ifd, ev, sizeof(ev));
+        if(n<=0) return 0;
+        for(char *p=ev; p<ev+n; p+=sizeof(struct inotify_event)+((struct inotify_event *)p)->len)
+            if(((struct inotify_event *)p)->mask & (IN_MOVE_SELF | IN_DELETE_SELF))
+                f->pending=1; //--rotated: watch for the new file until it shows up
+#endif
+    }
+    
+    int changed=0;
+    struct stat st;
+    if(fstat(f->fd, &st)==-1) return 0;
+    if(st.st_size < f->offset){ //--truncated in place (copytruncate)
+        editorSetStatusMessage("%s: file truncated", E.filename);
+        f->offset=0;
+        f->partial=0;
+    }
+    
+    char *buf=malloc(KILO_FOLLOW_READ);
+    ssize_t n;
+    while((n = pread(f->fd, buf, KILO_FOLLOW_READ, f->offset)) > 0){
+        editorFollowAppend(buf, n);
+        f->offset+=n;
+        changed=1;
+    }
+    free(buf);
+    
+    struct stat pst;
+    if(stat(E.filename, &pst)==-1){ //--mid rotation, keep looking for the new file
+        if(f->ifd!=-1) f->pending=1;
+        return changed;
+    }
+    if(pst.st_ino!=f->ino || pst.st_dev!=f->dev){ //--rotated, the old one is drained
+        int fd=open(E.filename, O_RDONLY);
+        if(fd!=-1){
+            close(f->fd);
+            f->fd=fd;
+            f->ino=pst.st_ino;
+            f->dev=pst.st_dev;
+            f->offset=0;
+            f->partial=0;
+            f->pending=1; //--read what the new file already holds next tick
+#ifdef __linux__
+            if(f->ifd!=-1){
+                inotify_rm_watch(f->ifd, f->wd);
+                f->wd=inotify_add_watch(f->ifd, E.filename, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+            }
+#endif
+            editorSetStatusMessage("%s: file rotated", E.filename);
+            return 1;
+        }
+    }else if(f->ifd!=-1){
+        f->pending=0;
+    }
+    return changed;
+}
+
+void editorFollowStop(){
+    struct editorFollow *f=&E.follow;
+    if(!f->on) return;
+    if(f->ifd!=-1) close(f->ifd);
+    close(f->fd);
+    f->on=0;
+    f->ifd=-1;
+}
+
+void editorFollowToggle(){
+    struct editorFollow *f=&E.follow;
+    if(f->on){
+        editorFollowStop();
+        editorSetStatusMessage("Follow mode off");
+        return;
+    }
+    
+    if(E.gzip){
+        editorSetStatusMessage("Follow mode can't follow a compressed file");
+        return;
+    }
+    struct stat st;
+    f->fd = E.filename ? open(E.filename, O_RDONLY) : -1;
+    if(f->fd==-1 || fstat(f->fd, &st)==-1 || !S_ISREG(st.st_mode)){
+        if(f->fd!=-1) close(f->fd);
+        f->fd=-1;
+        editorSetStatusMessage("Follow mode needs a regular file");
+        return;
+    }
+    f->on=1;
+    f->dev=st.st_dev;
+    f->ino=st.st_ino;
+    f->pending=1; //--catch up with what was written since the open
+    f->ifd=-1;
+#ifdef __linux__
+    f->ifd=inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(f->ifd!=-1)
+        f->wd=inotify_add_watch(f->ifd, E.filename, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+#endif
+    editorSetStatusMessage("Following %s (CTRL-T to stop)", E.filename);
+    editorFollowPoll();
+}
+
+/* buffers */
+
+void editorBufferStash(editorBuffer *b){
+    b->cx=E.cx; b->cy=E.cy; b->rx=E.rx;
+    b->rowoff=E.rowoff; b->coloff=E.coloff;
+    b->numrows=E.numrows;
+    b->row=E.row;
+    b->rowbytes=E.rowbytes;
+    b->dirty=E.dirty;
+    b->filename=E.filename;
+    b->gzip=E.gzip;
+    b->syntax=E.syntax;
+    b->journal=E.journal;
+    b->undo=E.undo;
+    b->follow=E.follow;
+    b->view=E.view;
+    b->brackets=E.brackets;
+    b->diff=E.diff;
+    b->hex=E.hex;
+    b->locations=E.locations;
+    b->derived=1;
+}
+
+void editorBufferRestore(editorBuffer *b){
+    E.cx=b->cx; E.cy=b->cy; E.rx=b->rx;
+    E.rowoff=b->rowoff; E.coloff=b->coloff;
+    E.numrows=b->numrows;
+    E.row=b->row;
+    E.rowbytes=b->rowbytes;
+    E.dirty=b->dirty;
+    E.filename=b->filename;
+    E.gzip=b->gzip;
+    E.syntax=b->syntax;
+    E.journal=b->journal;
+    E.undo=b->undo;
+    E.follow=b->follow;
+    E.view=b->view;
+    E.brackets=b->brackets;
+    E.diff=b->diff;
+    E.hex=b->hex;
+    E.locations=b->locations;
+}
+
+/*
+ -->an empty, unnamed buffer in E, what the editor starts with
+ */
+void editorBufferReset(){
+    E.cx=0;
+    E.cy=0;
+    E.rx=0;
+    E.rowoff=0;
+    E.coloff=0;
+    E.numrows=0;
+    E.row=NULL;
+    E.rowbytes=0;
+    E.dirty = 0;
+    E.filename=NULL;
+    E.gzip=0;
+    E.syntax=NULL;
+    E.journal.fd=-1;
+    E.journal.suspended=0;
+    E.journal.buf=NULL;
+    E.journal.len=E.journal.cap=0;
+    E.journal.unsynced=0;
+    E.journal.last_sync=0;
+    memset(&E.undo, 0, sizeof(E.undo));
+    memset(&E.follow, 0, sizeof(E.follow));
+    E.follow.fd=-1;
+    E.follow.ifd=-1;
+    memset(&E.view, 0, sizeof(E.view));
+    memset(&E.brackets, 0, sizeof(E.brackets));
+    memset(&E.diff, 0, sizeof(E.diff));
+    memset(&E.hex, 0, sizeof(E.hex));
+    E.locations=0;
+}
+
+void editorBufferSetFrame(editorBuffer *b, struct abuf *ab){
+    editorMemAdd(MEM_OUTPUT, ab->len - b->frame.len);
+    abFree(&b->frame);
+    b->frame=*ab;
+}
+
+/*
+ -->puts E away into its slot and brings buffer n in, nothing else
+ */
+void editorBufferSwap(int n){
+    editorBufferStash(&E.buffers[E.current]);
+    E.current=n;
+    editorBufferRestore(&E.buffers[n]);
+}
+
+/*
+ -->opens a file in a buffer of its own, or in E if that is still the empty
+    buffer of the start, or goes to the buffer that has it; -1 if it can't be
+    read
+ */
+int editorBufferOpen(char *filename){
+    struct stat st, bst;
+    if(access(filename, R_OK)==-1 || stat(filename, &st)==-1) return -1;
+    for(int k=0; k<E.nbuffers; k++){ //--open already, under whatever name: just go there
+        char *name = k==E.current ? E.filename : E.buffers[k].filename;
+        if(name && stat(name, &bst)==0 && bst.st_dev==st.st_dev && bst.st_ino==st.st_ino){
+            editorBufferSwitch(k);
+            return 0;
+        }
+    }
+    
+    editorBufferNew();
+    editorOpen(filename);
+    return 0;
+}
+
+/*
+ -->makes E an empty buffer, a new one unless the current one is empty
+ */
+void editorBufferNew(){
+    if(E.nbuffers==0){
+        E.buffers=calloc(1, sizeof(editorBuffer));
+        E.nbuffers=1;
+        E.current=0;
+    }
+    if(E.filename || E.numrows || E.hex.on){
+        E.buffers=realloc(E.buffers, sizeof(editorBuffer)*(E.nbuffers+1));
+        memset(&E.buffers[E.nbuffers], 0, sizeof(editorBuffer));
+        editorBufferSwitch(E.nbuffers++); //--leaves E with the new, empty slot
+        editorBufferReset();
+    }
+    E.buffers[E.current].used=editorMonotonicMs();
+}
+
+/*
+ -->the buffer being left keeps its last screen and has its journal on disk
+    before anything else happens
+ */
+void editorBufferSwitch(int n){
+    if(n==E.current || n<0 || n>=E.nbuffers) return;
+    
+    editorJournalSync();
+    if(E.journal.fd != -1 && E.journal.unsynced){
+        fdatasync(E.journal.fd);
+        E.journal.unsynced=0;
+        E.journal.last_sync=editorMonotonicMs();
+    }
+    if(E.row){ //--a slot just added has nothing to show yet
+        struct abuf ab = ABUF_INIT;
+        editorDrawFrame(&ab);
+        editorBufferSetFrame(&E.buffers[E.current], &ab);
+    }
+    
+    editorBufferSwap(n);
+    E.buffers[n].used=editorMonotonicMs();
+}
+
+void editorBufferNext(){
+    if(E.nbuffers<2){
+        editorSetStatusMessage("No other buffer, CTRL-O opens one");
+        return;
+    }
+    editorBufferSwitch((E.current+1) % E.nbuffers);
+    editorSetStatusMessage("Buffer %d/%d: %s", E.current+1, E.nbuffers,
+                           E.filename ? E.filename : "[No Name]");
+}
+
+void editorBufferClose(){
+    if(E.dirty){
+        editorSetStatusMessage("Unsaved changes, save before closing the buffer");
+        return;
+    }
+    editorCloseFile();
+    if(E.nbuffers<2) return; //--the last one stays, empty
+    
+    free(E.journal.buf);
+    editorBuffer *b=&E.buffers[E.current];
+    editorMemAdd(MEM_OUTPUT, -b->frame.len);
+    abFree(&b->frame);
+    memmove(b, b+1, sizeof(editorBuffer)*(E.nbuffers-E.current-1));
+    E.nbuffers--;
+    E.current = E.current>0 ? E.current-1 : 0;
+    editorBufferRestore(&E.buffers[E.current]);
+    E.buffers[E.current].used=editorMonotonicMs();
+}
+
+int editorBufferDirty(){
+    if(E.dirty) return 1;
+    for(int k=0; k<E.nbuffers; k++)
+        if(k!=E.current && E.buffers[k].dirty) return 1;
+    return 0;
+}
+
+void editorBufferDiscardJournals(){
+    int current=E.current;
+    for(int k=0; k<E.nbuffers; k++){
+        if(k==current) continue;
+        editorBufferSwap(k);
+        editorJournalDiscard();
+    }
+    if(E.nbuffers) editorBufferSwap(current);
+    editorJournalDiscard();
+}
+
+/* find */
+
+void editorFindCallback(char *query, int key){
+    static int last_match = -1;
+    static int direction = 1;
+    
+    static int saved_hl_line;
+    static char *saved_hl=NULL;
+    static int saved_len;
+    
+    if(saved_hl){
+        erow *row = saved_hl_line < E.numrows ? &E.row[saved_hl_line] : NULL;
+        if(row && row->hl) //--in the server another client may have changed the row meanwhile
+            memcpy(row->hl, saved_hl, row->rsize < saved_len ? row->rsize : saved_len);
+        editorMemAdd(MEM_SEARCH, -saved_len);
+        free(saved_hl);
+        saved_hl=NULL;
+    }
+    
+    if(key=='\r' || key=='\x1b'){
+        last_match = -1;
+        direction =1;
+        return;
+    }
+    else if(key == ARROW_RIGHT || key ==ARROW_DOWN) direction =1;
+    else if(key ==ARROW_LEFT || key ==ARROW_UP) direction =-1;
+    else{
+        last_match =-1;
+        direction =1;
+    }
+    
+    if(last_match ==-1) direction =1;
+    int current = last_match;
+    int i;
+    for(i=0; i<E.numrows; i++){
+        current += direction;
+        if(current==-1) current = E.numrows-1;
+        else if(current == E.numrows) current=0;
+        
+        erow *row = &E.row[current];
+        if(!row->render){
+            //--dropped by the memory budget: the text says whether it is worth
+            //bringing render back for the exact match. Render only differs by
+            //tabs turned into spaces, so a query with a space can match a row
+            //with a tab that its text does not have.
+            int exact = row->rsize==row->size || !strchr(query, ' ');
+            if(exact && !strstr(row->chars, query)) continue;
+            editorRowEnsureDerived(row);
+        }
+        char *match = strstr(row->render, query);
+        if(match){
+            last_match = current;
+            E.cy =current;
+            E.cx = editorRowRxtoCx(row, match- row->render);
+            E.rowoff = E.numrows;
+            
+            saved_hl_line= current;
+            saved_hl = malloc(row->rsize);
+            saved_len = row->rsize;
+            editorMemAdd(MEM_SEARCH, row->rsize);
+            memcpy(saved_hl, row->hl, row->rsize);
+            memset(&row->hl[match-row->render], HL_MATCH, strlen(query));
+            break;
+        }
+    }
+}
+
+void editorFind(){
+    int saved_cx = E.cx;
+    int saved_cy = E.cy;
+    int saved_coloff = E.coloff;
+    int saved_rowoff = E.rowoff;
+    int saved_segoff = E.view.segoff;
+    
+    char *query = editorPrompt("Search: %s (Use ESC/Arrows/Enter)", editorFindCallback);
+    
+    if(query) free(query);
+    else{
+        E.cx = saved_cx;
+        E.cy= saved_cy;
+        E.rowoff = saved_rowoff;
+        E.view.segoff = saved_segoff;
+        E.coloff = saved_coloff;
+    }
+}
+
+void editorGotoLine(){
+    char *query = editorPrompt("Go to line: %s (ESC to cancel)", NULL);
+    if(query==NULL) return;
+    
+    int line = atoi(query);
+    free(query);
+    if(line<1) line=1;
+    if(line>E.numrows) line=E.numrows; //--rows are an array, the jump is O(1)
+    E.cy = line>0 ? line-1 : 0;
+    E.cx = 0;
+}
+
+/* latency */
+
+const char *latency_names[PROBE_COUNT]={
+    "editorReadKey", "editorProcessKeypress", "editorUpdateSyntax",
+    "editorDrawRows", "write"
+};
+
+long long editorLatencyNow(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+/*
+ -->values below 16 ns get a bucket each, above that every power of two is
+    split into 16 buckets, so the error stays under 1/16 at any scale
+ */
+int editorLatencyBucket(unsigned long long v){
+    if(v < (1u<<KILO_LATENCY_SUB_BITS)) return v;
+    int e = 63-__builtin_clzll(v);
+    int sub = (v >> (e-KILO_LATENCY_SUB_BITS)) & ((1<<KILO_LATENCY_SUB_BITS)-1);
+    return ((e-KILO_LATENCY_SUB_BITS+1)<<KILO_LATENCY_SUB_BITS) + sub;
+}
+
+unsigned long long editorLatencyBucketTop(int b){
+    if(b < (1<<KILO_LATENCY_SUB_BITS)) return b;
+    int e = (b>>KILO_LATENCY_SUB_BITS) + KILO_LATENCY_SUB_BITS-1;
+    unsigned long long sub = b & ((1<<KILO_LATENCY_SUB_BITS)-1);
+    unsigned long long low = ((1ULL<<KILO_LATENCY_SUB_BITS)+sub) << (e-KILO_LATENCY_SUB_BITS);
+    return low + (1ULL<<(e-KILO_LATENCY_SUB_BITS)) - 1;
+}
+
+void editorLatencyAdd(int probe, long long start){
+    struct editorLatency *l = &E.latency;
+    long long now = editorLatencyNow();
+    unsigned long long dur = now-start;
+    struct latencyHist *h = &l->hist[probe];
+    h->count++;
+    h->counts[editorLatencyBucket(dur)]++;
+    if(dur > h->max) h->max=dur;
+    if(l->events){
+        struct latencyEvent *ev = &l->events[l->nevents++ % KILO_TRACE_EVENTS];
+        ev->ts=start-l->t0;
+        ev->dur=dur;
+        ev->probe=probe;
+    }
+}
+
+unsigned long long editorLatencyPercentile(const struct latencyHist *h, double p){
+    if(h->count==0) return 0;
+    unsigned long long want = h->count*p;
+    if(want==0) want=1;
+    unsigned long long seen=0;
+    for(int b=0; b<KILO_LATENCY_BUCKETS; b++){
+        seen+=h->counts[b];
+        if(seen>=want) return editorLatencyBucketTop(b) < h->max ? editorLatencyBucketTop(b) : h->max;
+    }
+    return h->max;
+}
+
+void editorLatencyFrame(long long bytes){
+    if(!E.latency.on) return;
+    E.latency.frames++;
+    E.latency.frame_bytes+=bytes;
+    E.latency.last_frame_bytes=bytes;
+}
+
+/*
+ -->turns the probes on; with a path, the events are also kept for a Chrome
+    trace (chrome://tracing, Perfetto) written by editorLatencyDump
+ */
+void editorLatencyStart(char *trace){
+    struct editorLatency *l = &E.latency;
+    if(!l->on) l->t0=editorLatencyNow();
+    l->on=1;
+    if(trace && !l->events){
+        l->events=malloc(sizeof(struct latencyEvent)*KILO_TRACE_EVENTS);
+        l->trace=trace;
+    }
+}
+
+void editorLatencyToggleOverlay(){
+    E.latency.overlay=!E.latency.overlay;
+    if(E.latency.overlay) editorLatencyStart(NULL);
+}
+
+void editorLatencyDump(){
+    struct editorLatency *l = &E.latency;
+    if(!l->events) return;
+    FILE *fp=fopen(l->trace, "w");
+    if(!fp) return;
+    long long first = l->nevents > KILO_TRACE_EVENTS ? l->nevents-KILO_TRACE_EVENTS : 0;
+    fprintf(fp, "{\"traceEvents\": [");
+    for(long long k=first; k<l->nevents; k++){
+        struct latencyEvent *ev = &l->events[k % KILO_TRACE_EVENTS];
+        fprintf(fp, "%s\n  {\"name\": \"%s\", \"cat\": \"kilo\", \"ph\": \"X\", "
+                "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": 1}",
+                k>first ? "," : "", latency_names[ev->probe], ev->ts/1000.0, ev->dur/1000.0);
+    }
+    fprintf(fp, "\n],\n\"displayTimeUnit\": \"ns\",\n\"otherData\": {\"frames\": %lld, \"frame_bytes\": %lld}}\n",
+            l->frames, l->frame_bytes);
+    fclose(fp);
+}
+
+/*
+ -->p50/p99/max per probe in us, and the size of the frames
+ */
+int editorLatencyOverlay(char *buf, int size){
+    static const char *shortnames[PROBE_COUNT]={"read", "key", "syn", "rows", "write"};
+    struct editorLatency *l = &E.latency;
+    int len=0;
+    for(int p=0; p<PROBE_COUNT && len<size; p++){
+        struct latencyHist *h = &l->hist[p];
+        len+=snprintf(buf+len, size-len, "%s %llu/%llu/%llu ", shortnames[p],
+                      editorLatencyPercentile(h, 0.5)/1000, editorLatencyPercentile(h, 0.99)/1000,
+                      h->max/1000);
+    }
+    if(len<size)
+        len+=snprintf(buf+len, size-len, "us | %lldB/frame avg %lld",
+                      l->last_frame_bytes, l->frames ? l->frame_bytes/l->frames : 0);
+    return len<size ? len : size-1;
+}
+
+/* memory */
+
+/*
+ -->row workers of editorOpen account from several threads at once
+ */
+void editorMemAdd(int kind, long long delta){
+    struct editorMemory *m = &E.mem;
+    long long now = __atomic_add_fetch(&m->cur[kind], delta, __ATOMIC_RELAXED);
+    long long peak = __atomic_load_n(&m->peak[kind], __ATOMIC_RELAXED);
+    while(now > peak && !__atomic_compare_exchange_n(&m->peak[kind], &peak, now, 1,
+                                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+long long editorMemTotal(){
+    long long total=0;
+    for(int k=0; k<MEM_COUNT; k++) total+=E.mem.cur[k];
+    return total;
+}
+
+/*
+ -->over the budget, render and hl of off-screen rows go until 1/8 of it is
+    free again; they come back when a row is drawn, searched or highlighted.
+    The text itself is never dropped, a budget below it only costs time.
+ */
+void editorMemEnforce(){
+    struct editorMemory *m = &E.mem;
+    if(m->budget==0 || editorMemTotal() <= m->budget) return;
+    long long target = m->budget - m->budget/8;
+    
+    //--buffers that are not on screen go first, the least recently seen first
+    while(editorMemTotal() > target){
+        editorBuffer *lru=NULL;
+        for(int k=0; k<E.nbuffers; k++)
+            if(k!=E.current && E.buffers[k].derived && (!lru || E.buffers[k].used < lru->used))
+                lru=&E.buffers[k];
+        if(!lru) break;
+        for(int j=0; j<lru->numrows; j++) editorRowDropDerived(&lru->row[j]);
+        lru->derived=0;
+    }
+    if(E.numrows==0 || editorMemTotal() <= target) return;
+    
+    long long visible=0;
+    int top=E.rowoff, bottom=E.rowoff+E.screenrows;
+    if(editorViewIndexed()){ //--folds and wrap: the screen ends where its last display line is
+        int seg;
+        bottom = editorViewFind(editorViewPrefix(E.rowoff)+E.view.segoff+E.screenrows-1, &seg)+1;
+    }
+    for(int j=top; j<bottom && j<E.numrows; j++)
+        if(E.row[j].render) visible+=2*(E.row[j].rsize+1);
+    if(m->cur[MEM_RENDER]+m->cur[MEM_HL] <= visible) return; //--nothing left to drop
+    
+    int j = m->drop_next % E.numrows;
+    for(int k=0; k<E.numrows && editorMemTotal() > target; k++, j=(j+1)%E.numrows)
+        if(j<top || j>=bottom) editorRowDropDerived(&E.row[j]);
+    m->drop_next=j;
+}
+
+int editorMemFormat(char *buf, int size, long long bytes){
+    if(bytes < 10*1024) return snprintf(buf, size, "%lld", bytes);
+    if(bytes < 10*1024*1024) return snprintf(buf, size, "%lldK", bytes/1024);
+    if(bytes < 10LL*1024*1024*1024) return snprintf(buf, size, "%lldM", bytes/(1024*1024));
+    return snprintf(buf, size, "%lldG", bytes/(1024*1024*1024));
+}
+
+/*
+ -->what malloc really keeps for the row buffers beyond the bytes asked of it:
+    rounding and chunk headers
+ */
+long long editorMemOverheadRows(erow *rows, int numrows){
+    long long over=0;
+    for(int j=0; j<numrows; j++){
+        erow *row=&rows[j];
+        void *p[3]={row->chars, row->render, row->hl};
+        long long asked[3]={row->size+1, row->rsize+1, row->rsize+1};
+        for(int k=0; k<3; k++){
+            if(!p[k]) continue;
+#ifdef __GLIBC__
+            over+=malloc_usable_size(p[k]) - asked[k] + sizeof(size_t);
+#else
+            (void)asked;
+            over+=2*sizeof(size_t); //--a typical header, the rounding is unknown
+#endif
+        }
+    }
+    return over;
+}
+
+/*
+ -->current/peak per subsystem and bytes per line in the message bar, a
+    page at a time so that it fits 80 columns; every call shows the next page
+ */
+void editorMemReport(){
+    static const char *names[MEM_COUNT]={"text", "render", "hl", "rows", "search", "out"};
+    static int page=0;
+    struct editorMemory *m = &E.mem;
+    char msg[sizeof(E.statusmsg)], cur[16], peak[16];
+    int len=0;
+    long long over = editorMemOverheadRows(E.row, E.numrows);
+    long long lines = E.numrows;
+    for(int b=0; b<E.nbuffers; b++){
+        if(b==E.current) continue;
+        over+=editorMemOverheadRows(E.buffers[b].row, E.buffers[b].numrows);
+        lines+=E.buffers[b].numrows;
+    }
+    if(lines==0) lines=1;
+    
+    if(page<2){
+        int from = page==0 ? MEM_CHARS : MEM_ROWS;
+        int to = page==0 ? MEM_HL : MEM_OUTPUT;
+        for(int k=from; k<=to; k++){
+            editorMemFormat(cur, sizeof(cur), m->cur[k]);
+            editorMemFormat(peak, sizeof(peak), m->peak[k]);
+            len+=snprintf(msg+len, sizeof(msg)-len, "%s%s %s/%s", k>from ? " | " : "",
+                          names[k], cur, peak);
+            if(k<=MEM_HL)
+                len+=snprintf(msg+len, sizeof(msg)-len, " %lldB/l", m->cur[k]/lines);
+            if(k==MEM_ROWS){
+                editorMemFormat(cur, sizeof(cur), m->cur[k]-(long long)sizeof(erow)*lines);
+                len+=snprintf(msg+len, sizeof(msg)-len, " (%s slack)", cur);
+            }
+        }
+    }else{
+        editorMemFormat(cur, sizeof(cur), over);
+        editorMemFormat(peak, sizeof(peak), m->budget);
+        snprintf(msg, sizeof(msg), "malloc +%s %lldB/l | budget %s, %lld dropped", cur,
+                 over/lines, m->budget ? peak : "none", m->dropped);
+    }
+    editorSetStatusMessage("mem %d/3: %s", page+1, msg);
+    page=(page+1)%3;
+}
+
+/* view index */
+
+/*
+ -->with soft wrap on a row takes ceil(rsize/width) display lines, an empty
+    one still takes one. The counts come from rsize alone, so rows whose
+    render the memory budget dropped keep their place.
+ */
+int editorWrapSegs(int rsize){
+    int w = editorTextCols();
+    return rsize ? (rsize+w-1)/w : 1;
+}
+
+int editorRowLines(erow *row){
+    if(row->hidden) return 0;
+    return E.view.wrap ? editorWrapSegs(row->rsize) : 1;
+}
+
+/*
+ -->the index is only kept while something makes display lines differ from
+    rows: soft wrap or a closed fold
+ */
+int editorViewIndexed(){
+    return E.view.wrap || E.view.nfolds;
+}
+
+void editorViewUpdate(int at, int delta){
+    if(delta==0) return;
+    for(int i=at+1; i<=E.view.valid; i+=i&-i) E.view.tree[i]+=delta;
+}
+
+/*
+ -->rows from at on moved; their entries are rebuilt on the next use, which
+    for rows added at the end (opening, follow mode) is only the new ones
+ */
+void editorViewInvalidate(int at){
+    if(at < E.view.valid) E.view.valid=at;
+}
+
+/*
+ -->brings the tree up to E.numrows rows at the current width. An entry is
+    its own row plus the entries under it, i-1, i-2, i-4 ... down to
+    i-lowbit(i)+1, all done already when going up: O(n) for a full build.
+ */
+void editorViewSync(){
+    struct editorView *w=&E.view;
+    int width = w->wrap ? editorTextCols() : 0;
+    if(w->width != width){
+        w->width=width;
+        w->valid=0;
+    }
+    if(w->n < E.numrows){
+        int n = E.numrows + E.numrows/4 + 16;
+        w->tree=realloc(w->tree, sizeof(int)*(n+1));
+        editorMemAdd(MEM_ROWS, (long long)sizeof(int)*(n-w->n)); //--counted with the row array
+        w->n=n;
+    }
+    if(w->valid > E.numrows) w->valid=E.numrows;
+    for(int i=w->valid+1; i<=E.numrows; i++){
+        int sum = editorRowLines(&E.row[i-1]);
+        for(int step=1; step<(i&-i); step<<=1) sum+=w->tree[i-step];
+        w->tree[i]=sum;
+    }
+    w->valid=E.numrows;
+}
+
+int editorViewPrefix(int rows){ //--display lines of rows [0, rows)
+    int sum=0;
+    if(rows>E.numrows) rows=E.numrows;
+    for(int i=rows; i>0; i-=i&-i) sum+=E.view.tree[i];
+    return sum;
+}
+
+/*
+ -->the row holding display line line, and the display line within it, by
+    walking down the tree; hidden rows hold no line, so they are never found
+ */
+int editorViewFind(int line, int *seg){
+    int pos=0, rest=line;
+    int step=1;
+    while(step*2 <= E.numrows) step*=2;
+    for(; step; step/=2)
+        if(pos+step <= E.numrows && E.view.tree[pos+step] <= rest){
+            pos+=step;
+            rest-=E.view.tree[pos];
+        }
+    *seg = pos<E.numrows ? rest : 0;
+    return pos;
+}
+
+int editorViewCursorLine(int *col){
+    int seg=0;
+    if(E.view.wrap && E.cy < E.numrows){
+        seg = E.rx / E.view.width;
+        int segs = editorWrapSegs(E.row[E.cy].rsize);
+        if(seg >= segs) seg = segs-1; //--just past the end of a full line
+    }
+    if(col) *col = E.rx - seg*E.view.width;
+    return editorViewPrefix(E.cy) + seg;
+}
+
+/*
+ -->the next row the cursor can be on, up or down, over closed folds
+ */
+int editorViewStep(int cy, int dir){
+    if(!E.view.nfolds){
+        cy+=dir;
+    }else{
+        int seg;
+        editorViewSync();
+        if(dir>0 && cy<E.numrows) cy = editorViewFind(editorViewPrefix(cy+1), &seg);
+        else if(dir<0 && editorViewPrefix(cy)>0) cy = editorViewFind(editorViewPrefix(cy)-1, &seg);
+        else if(dir<0) cy = 0;
+    }
+    if(cy<0) cy=0;
+    if(cy>E.numrows) cy=E.numrows;
+    return cy;
+}
+
+void editorViewScroll(){
+    if(E.cy < E.numrows && E.row[E.cy].hidden) editorFoldReveal(E.cy); //--find, goto, undo
+    editorViewSync();
+    if(E.view.wrap){
+        E.coloff=0;
+    }else{
+        if(E.rx < E.coloff) E.coloff = E.rx;
+        if(E.rx >= E.coloff + editorTextCols()) E.coloff = E.rx - editorTextCols()+1;
+    }
+    int cursor = editorViewCursorLine(NULL);
+    int top = editorViewPrefix(E.rowoff) + (E.rowoff<E.numrows ? E.view.segoff : 0);
+    if(cursor < top) top=cursor;
+    if(cursor >= top+E.screenrows) top=cursor-E.screenrows+1;
+    E.rowoff = editorViewFind(top, &E.view.segoff);
+}
+
+void editorCursorOnScreen(int *y, int *x){
+    if(E.hex.on){
+        editorHexCursor(y, x);
+        return;
+    }
+    if(!editorViewIndexed()){
+        *y = E.cy-E.rowoff;
+        *x = E.rx-E.coloff + (E.diff.on ? KILO_DIFF_GUTTER : 0);
+        return;
+    }
+    *y = editorViewCursorLine(x) - (editorViewPrefix(E.rowoff) + E.view.segoff);
+    if(!E.view.wrap) *x = E.rx-E.coloff;
+    if(E.diff.on) *x += KILO_DIFF_GUTTER;
+}
+
+/*
+ -->a page is a screen of display lines, the view and the cursor move together
+ */
+void editorViewPage(int dir){
+    editorScroll();
+    int col;
+    int cursor = editorViewCursorLine(&col);
+    int total = editorViewPrefix(E.numrows);
+    int top = editorViewPrefix(E.rowoff) + E.view.segoff;
+    
+    cursor += dir*E.screenrows;
+    top += dir*E.screenrows;
+    if(cursor<0) cursor=0;
+    if(cursor>total) cursor=total;
+    if(top<0) top=0;
+    if(top>cursor) top=cursor;
+    
+    int seg;
+    E.cy = editorViewFind(cursor, &seg);
+    E.cx = E.cy<E.numrows ? editorRowRxtoCx(&E.row[E.cy], seg*E.view.width + col) : 0;
+    E.rowoff = editorViewFind(top, &E.view.segoff);
+}
+
+void editorWrapToggle(){
+    E.view.wrap = !E.view.wrap;
+    E.view.segoff=0;
+    E.coloff=0;
+    E.view.valid=0; //--other line counts, and edits made meanwhile did not keep it up
+    editorSetStatusMessage("Soft wrap %s", E.view.wrap ? "on" : "off");
+}
+
+/* folding */
+
+/*
+ -->the closed fold starting at row at, or -1; folds are kept sorted by start
+ */
+int editorFoldAt(int at){
+    int lo=0, hi=E.view.nfolds-1;
+    while(lo<=hi){
+        int mid=(lo+hi)/2;
+        if(E.view.folds[mid].start==at) return mid;
+        if(E.view.folds[mid].start<at) lo=mid+1;
+        else hi=mid-1;
+    }
+    return -1;
+}
+
+int editorRowIndent(erow *row){ //--columns of leading blanks, -1 for a blank row
+    int rx=0;
+    for(int j=0; j<row->size; j++){
+        if(row->chars[j]=='\t') rx+=KILO_TAB_STOP-(rx%KILO_TAB_STOP);
+        else if(row->chars[j]==' ') rx++;
+        else return rx;
+    }
+    return -1;
+}
+
+/*
+ -->the last row of what can be folded under row at: up to the bracket that
+    closes the ones it opens, the end of the comment block it opens, or
+    else the rows indented deeper than it; -1 for nothing
+ */
+int editorFoldRegion(int at){
+    erow *row=&E.row[at];
+    if(row->brace.net > 0){
+        int depth=row->brace.net;
+        return at+1<E.numrows ? editorBracketForward(at+1, &depth) : -1;
+    }
+    if(row->hl_open_comment && !(at>0 && E.row[at-1].hl_open_comment)){
+        for(int r=at+1; r<E.numrows; r++)
+            if(!E.row[r].hl_open_comment) return r;
+        return -1;
+    }
+    int base=editorRowIndent(row);
+    if(base<0) return -1;
+    int end=-1;
+    for(int r=at+1; r<E.numrows; r++){
+        int ind=editorRowIndent(&E.row[r]);
+        if(ind<0) continue; //--blank rows go with the block around them
+        if(ind<=base) break;
+        end=r;
+    }
+    return end;
+}
+
+/*
+ -->rows start+1..end get one more (or one less) closed fold over them. The
+    index follows row by row when that is cheaper than rebuilding the rest.
+ */
+void editorFoldHide(int start, int end, int hide){
+    int k=end-start, logn=1;
+    while((1<<logn) < E.numrows) logn++;
+    int patch = E.view.valid > start && (long long)k*logn < E.numrows-start;
+    for(int r=start+1; r<=end; r++){
+        erow *row=&E.row[r];
+        int before = patch ? editorRowLines(row) : 0;
+        row->hidden+=hide;
+        if(patch) editorViewUpdate(r, editorRowLines(row)-before);
+    }
+    if(!patch) editorViewInvalidate(start+1);
+}
+
+void editorFoldOpen(int f){
+    struct editorFold fold=E.view.folds[f];
+    memmove(&E.view.folds[f], &E.view.folds[f+1], sizeof(struct editorFold)*(E.view.nfolds-f-1));
+    E.view.nfolds--;
+    editorFoldHide(fold.start, fold.end, -1);
+}
+
+/*
+ -->opens whatever closed folds hide row at
+ */
+void editorFoldReveal(int at){
+    for(int f=E.view.nfolds-1; f>=0 && E.row[at].hidden; f--)
+        if(E.view.folds[f].start < at && at <= E.view.folds[f].end) editorFoldOpen(f);
+}
+
+void editorFoldToggle(){
+    if(E.cy>=E.numrows) return;
+    editorViewSync();
+    int f=editorFoldAt(E.cy);
+    if(f!=-1){
+        int n=E.view.folds[f].end-E.view.folds[f].start;
+        editorFoldOpen(f);
+        editorSetStatusMessage("Unfolded %d lines", n);
+        return;
+    }
+    
+    int end=editorFoldRegion(E.cy);
+    if(end<=E.cy){
+        editorSetStatusMessage("Nothing to fold here");
+        return;
+    }
+    struct editorView *v=&E.view;
+    if(v->nfolds==v->capfolds){
+        v->capfolds = v->capfolds ? v->capfolds*2 : 16;
+        v->folds = realloc(v->folds, sizeof(struct editorFold)*v->capfolds);
+    }
+    int at=0;
+    while(at<v->nfolds && v->folds[at].start<E.cy) at++;
+    memmove(&v->folds[at+1], &v->folds[at], sizeof(struct editorFold)*(v->nfolds-at));
+    v->folds[at].start=E.cy;
+    v->folds[at].end=end;
+    v->nfolds++;
+    editorFoldHide(E.cy, end, 1);
+    editorSetStatusMessage("Folded %d lines", end-E.cy);
+}
+
+/*
+ -->a row was added at at: folds after it move down, a fold around it
+    takes it in, hidden
+ */
+void editorFoldRowInserted(int at){
+    for(int f=0; f<E.view.nfolds; f++){
+        struct editorFold *fold=&E.view.folds[f];
+        if(fold->start >= at){
+            fold->start++;
+            fold->end++;
+        }else if(at <= fold->end){
+            fold->end++;
+            E.row[at].hidden++;
+        }
+    }
+}
+
+/*
+ -->row at was deleted: a fold loses it, and a fold whose first row it was
+    is opened
+ */
+void editorFoldRowDeleted(int at){
+    for(int f=E.view.nfolds-1; f>=0; f--){
+        struct editorFold *fold=&E.view.folds[f];
+        if(fold->start > at){
+            fold->start--;
+            fold->end--;
+        }else if(fold->start == at){
+            for(int r=at; r<fold->end && r<E.numrows; r++) E.row[r].hidden--;
+            memmove(fold, fold+1, sizeof(struct editorFold)*(E.view.nfolds-f-1));
+            E.view.nfolds--;
+        }else if(at <= fold->end){
+            if(--fold->end == fold->start){
+                memmove(fold, fold+1, sizeof(struct editorFold)*(E.view.nfolds-f-1));
+                E.view.nfolds--;
+            }
+        }
+    }
+}
+
+/* brackets */
+
+/*
+ -->+1 for an opening bracket at render column i, -1 for a closing one.
+    The three kinds count together, as a stack would: a partner of another
+    kind means the brackets around it don't balance.
+ */
+int editorBracketDelta(erow *row, int i){
+    if(row->hl[i]!=HL_NORMAL) return 0;
+    switch(row->render[i]){
+        case '(': case '[': case '{': return 1;
+        case ')': case ']': case '}': return -1;
+    }
+    return 0;
+}
+
+struct bracketSum editorBracketCombine(struct bracketSum a, struct bracketSum b){
+    struct bracketSum s;
+    s.net = a.net+b.net;
+    s.low = a.low < a.net+b.low ? a.low : a.net+b.low;
+    s.high = b.high > b.net+a.high ? b.high : b.net+a.high;
+    return s;
+}
+
+void editorBracketLeaf(int block){
+    struct bracketSum sum={0, 0, 0};
+    int end=(block+1)*KILO_BRACKET_BLOCK;
+    if(end>E.numrows) end=E.numrows;
+    for(int r=block*KILO_BRACKET_BLOCK; r<end; r++)
+        sum=editorBracketCombine(sum, E.row[r].brace);
+    E.brackets.tree[E.brackets.cap+block]=sum;
+}
+
+void editorBracketUpdate(int at){
+    struct bracketSum *t=E.brackets.tree;
+    int node=E.brackets.cap + at/KILO_BRACKET_BLOCK;
+    editorBracketLeaf(at/KILO_BRACKET_BLOCK);
+    for(node/=2; node>=1; node/=2) t[node]=editorBracketCombine(t[2*node], t[2*node+1]);
+}
+
+/*
+ -->rows from at on moved to other blocks; like the view index, the blocks
+    from there on are rebuilt on the next lookup
+ */
+void editorBracketInvalidate(int at){
+    if(at < E.brackets.valid) E.brackets.valid=at;
+}
+
+void editorBracketSync(){
+    struct editorBrackets *b=&E.brackets;
+    int blocks=(E.numrows+KILO_BRACKET_BLOCK-1)/KILO_BRACKET_BLOCK;
+    if(b->cap < blocks || b->cap==0){
+        int cap=1;
+        while(cap<blocks) cap*=2;
+        b->tree=realloc(b->tree, sizeof(struct bracketSum)*2*cap);
+        editorMemAdd(MEM_ROWS, (long long)sizeof(struct bracketSum)*2*(cap-b->cap));
+        memset(b->tree, 0, sizeof(struct bracketSum)*2*cap); //--empty blocks are the identity
+        b->cap=cap;
+        b->valid=0;
+    }
+    if(b->valid==E.numrows && b->rows==E.numrows) return;
+    
+    int from=b->valid/KILO_BRACKET_BLOCK;
+    int to=(b->rows+KILO_BRACKET_BLOCK-1)/KILO_BRACKET_BLOCK; //--blocks that held rows before
+    if(to<blocks) to=blocks;
+    if(to>b->cap) to=b->cap;
+    for(int k=from; k<to; k++){
+        if(k<blocks) editorBracketLeaf(k);
+        else memset(&b->tree[b->cap+k], 0, sizeof(struct bracketSum));
+    }
+    for(int lo=(b->cap+from)/2, hi=(2*b->cap-1)/2; lo>=1; lo/=2, hi/=2)
+        for(int node=lo; node<=hi; node++)
+            b->tree[node]=editorBracketCombine(b->tree[2*node], b->tree[2*node+1]);
+    b->valid=b->rows=E.numrows;
+}
+
+int editorBracketDescendForward(int node, int nl, int nr, int from, int *depth){
+    struct bracketSum *t=E.brackets.tree;
+    if(nr<=from) return -1;
+    if(nl>=from && *depth + t[node].low > 0){ //--the count never gets to 0 in here
+        *depth+=t[node].net;
+        return -1;
+    }
+    if(node>=E.brackets.cap) return nl;
+    int mid=(nl+nr)/2;
+    int r=editorBracketDescendForward(2*node, nl, mid, from, depth);
+    return r!=-1 ? r : editorBracketDescendForward(2*node+1, mid, nr, from, depth);
+}
+
+int editorBracketDescendBackward(int node, int nl, int nr, int to, int *need){
+    struct bracketSum *t=E.brackets.tree;
+    if(nl>=to) return -1;
+    if(nr<=to && t[node].high < *need){
+        *need-=t[node].net;
+        return -1;
+    }
+    if(node>=E.brackets.cap) return nl;
+    int mid=(nl+nr)/2;
+    int r=editorBracketDescendBackward(2*node+1, mid, nr, to, need);
+    return r!=-1 ? r : editorBracketDescendBackward(2*node, nl, mid, to, need);
+}
+
+/*
+ -->with depth brackets open at the start of row, the first row from there
+    on in which they all get closed, or -1; depth is left at what it was at
+    the start of that row. Rows of the same block are looked at one by one,
+    the blocks after it through the tree.
+ */
+int editorBracketForward(int row, int *depth){
+    editorBracketSync();
+    int end=(row/KILO_BRACKET_BLOCK+1)*KILO_BRACKET_BLOCK;
+    for(; row<E.numrows && row<end; row++){
+        if(*depth + E.row[row].brace.low <= 0) return row;
+        *depth+=E.row[row].brace.net;
+    }
+    if(row>=E.numrows) return -1;
+    int block=editorBracketDescendForward(1, 0, E.brackets.cap, row/KILO_BRACKET_BLOCK, depth);
+    if(block==-1) return -1;
+    for(row=block*KILO_BRACKET_BLOCK; row<E.numrows; row++){
+        if(*depth + E.row[row].brace.low <= 0) return row;
+        *depth+=E.row[row].brace.net;
+    }
+    return -1;
+}
+
+/*
+ -->the same going up: with need closing brackets unmatched at the end of
+    row, the last row up to it that opens the one they are waiting for
+ */
+int editorBracketBackward(int row, int *need){
+    editorBracketSync();
+    int start=row/KILO_BRACKET_BLOCK*KILO_BRACKET_BLOCK;
+    for(; row>=0 && row>=start; row--){
+        if(E.row[row].brace.high >= *need) return row;
+        *need-=E.row[row].brace.net;
+    }
+    if(row<0) return -1;
+    int block=editorBracketDescendBackward(1, 0, E.brackets.cap, start/KILO_BRACKET_BLOCK, need);
+    if(block==-1) return -1;
+    for(row=(block+1)*KILO_BRACKET_BLOCK-1; row>=block*KILO_BRACKET_BLOCK; row--){
+        if(E.row[row].brace.high >= *need) return row;
+        *need-=E.row[row].brace.net;
+    }
+    return -1;
+}
+
+/*
+ -->the render column in row where the count, going from column from in
+    direction dir, gets back to 0, or -1
+ */
+int editorBracketScanRow(erow *row, int from, int dir, int *depth){
+    editorRowEnsureDerived(row);
+    for(int i=from; i>=0 && i<row->rsize; i+=dir){
+        *depth+=dir*editorBracketDelta(row, i);
+        if(*depth==0) return i;
+    }
+    return -1;
+}
+
+/*
+ -->the partner of the bracket at render column rx of row cy: 1 when found,
+    -1 when the brackets don't balance, 0 when there is no bracket there
+ */
+int editorBracketMatch(int cy, int rx, int *mrow, int *mrx){
+    if(cy>=E.numrows) return 0;
+    erow *row=&E.row[cy];
+    editorRowEnsureDerived(row);
+    if(rx<0 || rx>=row->rsize) return 0;
+    int dir=editorBracketDelta(row, rx);
+    if(dir==0) return 0;
+    
+    int depth=1;
+    int r=cy;
+    int x=editorBracketScanRow(row, rx+dir, dir, &depth);
+    if(x==-1){
+        if(dir>0) r = cy+1<E.numrows ? editorBracketForward(cy+1, &depth) : -1;
+        else r = cy>0 ? editorBracketBackward(cy-1, &depth) : -1;
+        if(r==-1) return -1;
+        x=editorBracketScanRow(&E.row[r], dir>0 ? 0 : E.row[r].rsize-1, dir, &depth);
+        if(x==-1) return -1;
+    }
+    *mrow=r;
+    *mrx=x;
+    const char *pairs="()[]{}";
+    char c=row->render[rx];
+    char partner=pairs[(strchr(pairs, c)-pairs)^1];
+    return E.row[r].render[x]==partner ? 1 : -1;
+}
+
+/*
+ -->the bracket at the cursor, or else the one just before it as after
+    typing a closing one
+ */
+int editorBracketAtCursor(int *mrow, int *mrx){
+    int found=editorBracketMatch(E.cy, E.rx, mrow, mrx);
+    if(found==0 && E.cx>0 && E.cy<E.numrows)
+        found=editorBracketMatch(E.cy, editorRowCxToRx(&E.row[E.cy], E.cx-1), mrow, mrx);
+    return found;
+}
+
+void editorBracketUpdateMatch(){
+    E.brackets.match = editorBracketAtCursor(&E.brackets.mrow, &E.brackets.mrx)==1;
+}
+
+void editorBracketJump(){
+    int mrow, mrx;
+    int found=editorBracketAtCursor(&mrow, &mrx);
+    if(found==0){
+        editorSetStatusMessage("No bracket at the cursor");
+        return;
+    }
+    if(found==-1){
+        editorSetStatusMessage("Unbalanced brackets");
+        return;
+    }
+    E.cy=mrow;
+    E.cx=editorRowRxtoCx(&E.row[mrow], mrx);
+}
+
+/* diff */
+
+/*
+ -->remembers which file the rows now match: the one on disk as it is now
+ */
+void editorDiffReset(){
+    struct stat st;
+    E.diff.touched=0;
+    E.diff.stale=1;
+    if(E.filename==NULL || stat(E.filename, &st)==-1) memset(&st, 0, sizeof(st));
+    E.diff.dev=st.st_dev;
+    E.diff.ino=st.st_ino;
+    E.diff.size=st.st_size;
+    E.diff.mtime=st.st_mtime;
+}
+
+/*
+ -->rows before at and the last after rows are as they were; everything
+    outside the range touched since the reset still matches the disk line
+    for line, and the diff only has to look inside it
+ */
+void editorDiffTouch(int at, int after){
+    if(after<0) after=0;
+    if(!E.diff.touched){
+        E.diff.touched=1;
+        E.diff.first=at;
+        E.diff.after=after;
+    }else{
+        if(at<E.diff.first) E.diff.first=at;
+        if(after<E.diff.after) E.diff.after=after;
+    }
+    E.diff.stale=1;
+}
+
+/*
+ -->linear space Myers: the middle snake of a[0,n) against b[0,m), the
+    diagonal run the forward and backward searches meet on, in vf and vb
+    indexed from off. -1 when they are more than KILO_DIFF_COST edits apart.
+ */
+int editorDiffSnake(const uint64_t *a, int n, const uint64_t *b, int m, int *vf, int *vb, int off,
+                    int *sx, int *sy, int *ex, int *ey){
+    int delta=n-m, odd=delta&1;
+    int max=(n+m+1)/2;
+    if(max>KILO_DIFF_COST) max=KILO_DIFF_COST;
+    vf[off+1]=0;
+    vb[off+1]=0;
+    for(int d=0; d<=max; d++){
+        for(int k=-d; k<=d; k+=2){
+            int x = (k==-d || (k!=d && vf[off+k-1] < vf[off+k+1])) ? vf[off+k+1] : vf[off+k-1]+1;
+            int y=x-k;
+            int x0=x, y0=y;
+            while(x<n && y<m && a[x]==b[y]) x++, y++;
+            vf[off+k]=x;
+            if(odd && delta-k >= -(d-1) && delta-k <= d-1 && x + vb[off+delta-k] >= n){
+                *sx=x0; *sy=y0; *ex=x; *ey=y;
+                return 2*d-1;
+            }
+        }
+        for(int k=-d; k<=d; k+=2){ //--the same on the reversed sequences
+            int x = (k==-d || (k!=d && vb[off+k-1] < vb[off+k+1])) ? vb[off+k+1] : vb[off+k-1]+1;
+            int y=x-k;
+            int x0=x, y0=y;
+            while(x<n && y<m && a[n-1-x]==b[m-1-y]) x++, y++;
+            vb[off+k]=x;
+            if(!odd && delta-k >= -d && delta-k <= d && x + vf[off+delta-k] >= n){
+                *sx=n-x; *sy=m-y; *ex=n-x0; *ey=m-y0;
+                return 2*d;
+            }
+        }
+    }
+    return -1;
+}
+
+/*
+ -->flags the lines of a that go and the lines of b that come
+ */
+void editorDiffRun(const uint64_t *a, int n, const uint64_t *b, int m, unsigned char *del,
+                   unsigned char *ins, int *vf, int *vb, int off){
+    while(n>0 && m>0 && a[0]==b[0]) a++, b++, del++, ins++, n--, m--;
+    while(n>0 && m>0 && a[n-1]==b[m-1]) n--, m--;
+    if(n==0 || m==0){
+        memset(del, 1, n);
+        memset(ins, 1, m);
+        return;
+    }
+    int sx, sy, ex, ey;
+    if(editorDiffSnake(a, n, b, m, vf, vb, off, &sx, &sy, &ex, &ey)==-1){
+        memset(del, 1, n); //--too far apart to be worth the time, all of it changed
+        memset(ins, 1, m);
+        return;
+    }
+    editorDiffRun(a, sx, b, sy, del, ins, vf, vb, off);
+    editorDiffRun(a+ex, n-ex, b+ey, m-ey, del+ex, ins+ey, vf, vb, off);
+}
+
+uint64_t editorDiffHashLine(const char *map, size_t from, size_t to){
+    while(to>from && (map[to-1]=='\n' || map[to-1]=='\r')) to--;
+    return editorHashBlock(&map[from], to-from) | 1; //--as the rows, where 0 is not hashed yet
+}
+
+/*
+ -->the line hashes of a gzip file, from its chunks as they are inflated
+ */
+void editorDiffGzipLines(lineIndex *hashes, const char *map, size_t size){
+    struct gzipReader r;
+    editorGzipStart(&r, map, size);
+    int cap=0;
+    char *buf;
+    size_t len;
+    while((buf = editorGzipNext(&r, &len)) != NULL){
+        lineIndex li;
+        editorIndexBuild(&li, buf, len);
+        if(hashes->n+li.n > cap){
+            cap = 2*(hashes->n+li.n);
+            hashes->start = realloc(hashes->start, sizeof(uint64_t)*cap);
+        }
+        for(int l=0; l<li.n; l++)
+            hashes->start[hashes->n++]=editorDiffHashLine(buf, li.start[l], l+1<li.n ? li.start[l+1] : len);
+        free(li.start);
+        free(buf);
+    }
+    editorGzipFinish(&r);
+}
+
+/*
+ -->the line hashes of the file as it is on disk, kept while it doesn't
+    change: after the first diff only the rows are hashed again
+ */
+void editorDiffLines(struct stat *st){
+    if(E.diff.lines && E.diff.lines_ino==(unsigned long long)st->st_ino &&
+       E.diff.lines_size==st->st_size && E.diff.lines_mtime==st->st_mtime) return;
+    lineIndex li={NULL, 0};
+    int fd=open(E.filename, O_RDONLY);
+    char *map = fd!=-1 ? mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if(fd!=-1) close(fd);
+    if(map!=MAP_FAILED && editorGzipDetect(map, st->st_size)){
+        editorDiffGzipLines(&li, map, st->st_size);
+    }else{
+        if(map!=MAP_FAILED) editorIndexBuild(&li, map, st->st_size);
+        for(int l=0; l<li.n; l++) //--in place, each start is read before it is overwritten
+            li.start[l]=editorDiffHashLine(map, li.start[l], l+1<li.n ? li.start[l+1] : (size_t)st->st_size);
+    }
+    if(map!=MAP_FAILED) munmap(map, st->st_size);
+    editorMemAdd(MEM_SEARCH, (long long)sizeof(uint64_t)*(li.n - E.diff.nlines));
+    free(E.diff.lines);
+    for(int j=0; j<E.diff.nhash; j++) E.diff.line[j]=-1; //--lines of another file
+    E.diff.lines=li.start;
+    E.diff.nlines=li.n;
+    E.diff.lines_ino=st->st_ino;
+    E.diff.lines_size=st->st_size;
+    E.diff.lines_mtime=st->st_mtime;
+}
+
+/*
+ -->rows [row, row+m) against disk lines [line, line+n): marks the rows
+    that differ, and the disk line of every row that matches
+ */
+void editorDiffGap(int row, int m, int line, int n){
+    if(n==0 && m==0) return;
+    uint64_t *a=E.diff.lines+line;
+    uint64_t *b=E.diff.hash+row;
+    for(int j=0; j<m; j++)
+        if(b[j]==0) b[j]=editorHashBlock(E.row[row+j].chars, E.row[row+j].size) | 1; //--0 is not hashed yet
+    
+    unsigned char *del=calloc(n+m+1, 1);
+    unsigned char *ins=del+n;
+    int off=(n+m+1)/2+2;
+    if(off>KILO_DIFF_COST+2) off=KILO_DIFF_COST+2;
+    int *vf=malloc(sizeof(int)*(2*off+2)*2);
+    int *vb=vf+2*off+2;
+    editorDiffRun(a, n, b, m, del, ins, vf, vb, off);
+    free(vf);
+    
+    //--a run of removed lines next to a run of added rows is a change
+    int i=0, j=0;
+    while(i<n || j<m){
+        if(i<n && j<m && !del[i] && !ins[j]){
+            E.diff.line[row+j]=line+i;
+            i++, j++;
+            continue;
+        }
+        int dc=0, ic=0;
+        while((i<n && del[i]) || (j<m && ins[j])){
+            if(i<n && del[i]) i++, dc++;
+            if(j<m && ins[j]) j++, ic++;
+        }
+        int at=row+j-ic;
+        for(int k=0; k<ic; k++) E.diff.marks[at+k] = k<dc ? DIFF_CHANGED : DIFF_ADDED;
+        E.diff.changed += dc<ic ? dc : ic;
+        if(ic>dc) E.diff.added += ic-dc;
+        if(dc>ic){
+            E.diff.removed += dc-ic;
+            int below=row+j;
+            if(below<E.numrows && E.diff.marks[below]==DIFF_SAME) E.diff.marks[below]=DIFF_REMOVED;
+            else if(below>0 && below>=E.numrows && E.diff.marks[below-1]==DIFF_SAME)
+                E.diff.marks[below-1]=DIFF_REMOVED; //--removed at the end of the file
+        }
+    }
+    free(del);
+}
+
+/*
+ -->keeps a hash and a disk line for every row while diff mode is on
+ */
+void editorDiffRows(){
+    if(E.diff.caphash < E.numrows){
+        int cap=E.numrows+E.numrows/4+16;
+        E.diff.hash=realloc(E.diff.hash, sizeof(uint64_t)*cap);
+        E.diff.line=realloc(E.diff.line, sizeof(int)*cap);
+        editorMemAdd(MEM_SEARCH, (long long)(sizeof(uint64_t)+sizeof(int))*(cap-E.diff.caphash));
+        E.diff.caphash=cap;
+    }
+    for(int j=E.diff.nhash; j<E.numrows; j++){ //--new, or added in bulk by follow mode
+        E.diff.hash[j]=0;
+        E.diff.line[j]=-1;
+    }
+    E.diff.nhash=E.numrows;
+}
+
+/*
+ -->marks every row as the same as on disk, added, changed, or next to
+    lines that were removed. Rows that matched a disk line in the last diff
+    and weren't edited since still do as long as the file is the same, so
+    only the stretches between them are diffed again; the pairing may then
+    differ from what a full diff would pick, never the lines that match.
+ */
+void editorDiffUpdate(){
+    long long t=editorMonotonicMs();
+    E.diff.stale=0;
+    if(E.diff.nmarks < E.numrows){
+        editorMemAdd(MEM_SEARCH, E.numrows - E.diff.nmarks);
+        E.diff.marks=realloc(E.diff.marks, E.numrows);
+        E.diff.nmarks=E.numrows;
+    }
+    memset(E.diff.marks, DIFF_SAME, E.numrows);
+    E.diff.added=E.diff.changed=E.diff.removed=0;
+    editorDiffRows();
+    
+    struct stat st;
+    int ndisk=0;
+    if(E.filename && stat(E.filename, &st)==0 && S_ISREG(st.st_mode) && st.st_size>0){
+        editorDiffLines(&st);
+        ndisk=E.diff.nlines;
+    }
+    
+    //--rows not touched since the file was read or written are its lines
+    if(ndisk && E.diff.ino==(unsigned long long)st.st_ino && E.diff.dev==(unsigned long long)st.st_dev &&
+       E.diff.size==st.st_size && E.diff.mtime==st.st_mtime){
+        int head = E.diff.touched ? E.diff.first : E.numrows;
+        int tail = E.diff.touched ? E.diff.after : 0;
+        int least = ndisk<E.numrows ? ndisk : E.numrows;
+        if(head>least) head=least;
+        if(tail>least-head) tail=least-head;
+        for(int j=0; j<head; j++) E.diff.line[j]=j;
+        for(int j=E.numrows-tail; j<E.numrows; j++) E.diff.line[j]=ndisk-(E.numrows-j);
+    }
+    
+    int row=0, line=0;
+    for(int j=0; j<E.numrows; j++){
+        int l=E.diff.line[j];
+        if(l<line || l>=ndisk){ //--none, or out of order after a change on disk
+            E.diff.line[j]=-1;
+            continue;
+        }
+        editorDiffGap(row, j-row, line, l-line);
+        row=j+1;
+        line=l+1;
+    }
+    editorDiffGap(row, E.numrows-row, line, ndisk-line);
+    E.diff.ms=editorMonotonicMs()-t;
+}
+
+/*
+ -->the row state moves with the rows, edited ones are hashed and matched
+    again
+ */
+void editorDiffRowInserted(int at){
+    if(!E.diff.hash || at > E.diff.nhash) return; //--past rows follow mode added
+    if(E.diff.nhash==E.diff.caphash){
+        int cap=E.diff.caphash*2;
+        E.diff.hash=realloc(E.diff.hash, sizeof(uint64_t)*cap);
+        E.diff.line=realloc(E.diff.line, sizeof(int)*cap);
+        editorMemAdd(MEM_SEARCH, (long long)(sizeof(uint64_t)+sizeof(int))*(cap-E.diff.caphash));
+        E.diff.caphash=cap;
+    }
+    memmove(&E.diff.hash[at+1], &E.diff.hash[at], sizeof(uint64_t)*(E.diff.nhash-at));
+    memmove(&E.diff.line[at+1], &E.diff.line[at], sizeof(int)*(E.diff.nhash-at));
+    E.diff.hash[at]=0;
+    E.diff.line[at]=-1;
+    E.diff.nhash++;
+}
+
+void editorDiffRowDeleted(int at){
+    if(!E.diff.hash || at >= E.diff.nhash) return;
+    memmove(&E.diff.hash[at], &E.diff.hash[at+1], sizeof(uint64_t)*(E.diff.nhash-at-1));
+    memmove(&E.diff.line[at], &E.diff.line[at+1], sizeof(int)*(E.diff.nhash-at-1));
+    E.diff.nhash--;
+}
+
+void editorDiffRowChanged(int at){
+    if(at >= E.diff.nhash) return;
+    E.diff.hash[at]=0;
+    E.diff.line[at]=-1;
+}
+
+void editorDiffToggle(){
+    E.diff.on=!E.diff.on;
+    E.view.valid=0; //--the gutter takes columns from the text
+    if(!E.diff.on){
+        editorDiffFree();
+        editorSetStatusMessage("Diff off");
+        return;
+    }
+    editorDiffUpdate();
+    editorSetStatusMessage("Diff against disk: %d added, %d changed, %d removed (%lld ms)",
+                           E.diff.added, E.diff.changed, E.diff.removed, E.diff.ms);
+}
+
+void editorDiffFree(){
+    editorMemAdd(MEM_SEARCH, -(E.diff.nmarks + (long long)sizeof(uint64_t)*E.diff.nlines +
+                               (long long)(sizeof(uint64_t)+sizeof(int))*E.diff.caphash));
+    free(E.diff.marks);
+    free(E.diff.lines);
+    free(E.diff.hash);
+    free(E.diff.line);
+    E.diff.marks=NULL;
+    E.diff.lines=NULL;
+    E.diff.hash=NULL;
+    E.diff.line=NULL;
+    E.diff.nmarks=E.diff.nlines=0;
+    E.diff.nhash=E.diff.caphash=0;
+}
+
+/*
+ -->columns of the screen left for text, after the diff gutter
+ */
+int editorTextCols(){
+    int cols = E.screencols - (E.diff.on ? KILO_DIFF_GUTTER : 0);
+    return cols>0 ? cols : 1;
+}
+
+void editorDrawGutter(struct abuf *ab, int filerow, int first){
+    if(!E.diff.on) return;
+    static const char *gutter[]={"  ", "\x1b[32m+\x1b[39m ", "\x1b[33m*\x1b[39m ", "\x1b[31m_\x1b[39m "};
+    int mark = (first && filerow<E.numrows && filerow<E.diff.nmarks) ? E.diff.marks[filerow] : DIFF_SAME;
+    abAppend(ab, gutter[mark], strlen(gutter[mark]));
+}
+
+/* hex view */
+
+/*
+ -->a file is binary if there is a NUL byte near its start, or if more than
+    one byte in 16 there is a control character text doesn't use
+ */
+int editorHexDetect(const char *map, size_t size){
+    size_t n = size<KILO_HEX_SNIFF ? size : KILO_HEX_SNIFF;
+    if(memchr(map, '\0', n)) return 1;
+    size_t odd=0;
+    for(size_t i=0; i<n; i++){
+        unsigned char c=map[i];
+        if(c<32 && c!='\n' && c!='\r' && c!='\t' && c!='\f' && c!='\b' && c!='\x1b') odd++;
+    }
+    return odd*16 > n;
+}
+
+void editorHexOpen(const char *map, size_t size){
+    E.hex.on=1;
+    E.hex.map=(const unsigned char *)map;
+    E.hex.size=size;
+    E.hex.top=E.hex.cur=0;
+}
+
+void editorHexClose(){
+    if(E.hex.on) munmap((void *)E.hex.map, E.hex.size);
+    memset(&E.hex, 0, sizeof(E.hex));
+}
+
+int editorHexDigits(){ //--of the offset column, 8 unless the file needs more
+    int d=8;
+    while(d<16 && (E.hex.size-1) >> (4*d)) d++;
+    return d;
+}
+
+void editorHexScroll(){
+    size_t line = E.hex.cur - E.hex.cur%KILO_HEX_WIDTH;
+    size_t page = (size_t)E.screenrows*KILO_HEX_WIDTH;
+    if(line < E.hex.top) E.hex.top=line;
+    if(line >= E.hex.top+page) E.hex.top=line-page+KILO_HEX_WIDTH;
+}
+
+void editorHexCursor(int *y, int *x){
+    int col = E.hex.cur%KILO_HEX_WIDTH;
+    *y = (E.hex.cur-E.hex.top)/KILO_HEX_WIDTH;
+    *x = editorHexDigits()+2 + col*3 + (col>=KILO_HEX_WIDTH/2);
+}
+
+/*
+ -->only the lines on screen are encoded, each straight from the mapping,
+    so where the view is in the file makes no difference. The hex digits
+    come two at a time from a table of all 256 bytes.
+ */
+void editorHexDrawRows(struct abuf *ab){
+    static char pairs[512];
+    if(!pairs[0])
+        for(int b=0; b<256; b++){
+            pairs[2*b]="0123456789abcdef"[b>>4];
+            pairs[2*b+1]="0123456789abcdef"[b&15];
+        }
+    
+    int digits=editorHexDigits();
+    char line[16+2+KILO_HEX_WIDTH*3+1+2+KILO_HEX_WIDTH+1+16];
+    for(int y=0; y<E.screenrows; y++){
+        size_t off = E.hex.top + (size_t)y*KILO_HEX_WIDTH;
+        if(off >= E.hex.size){
+            abAppend(ab, "~", 1);
+        }else{
+            int n = E.hex.size-off < KILO_HEX_WIDTH ? (int)(E.hex.size-off) : KILO_HEX_WIDTH;
+            const unsigned char *p = &E.hex.map[off];
+            int len = snprintf(line, sizeof(line), "%0*zx  ", digits, off);
+            int ascii = len + KILO_HEX_WIDTH*3 + 1 + 1;
+            memset(&line[len], ' ', ascii-len+KILO_HEX_WIDTH+1);
+            line[ascii-1]='|';
+            for(int k=0; k<n; k++){
+                memcpy(&line[len + k*3 + (k>=KILO_HEX_WIDTH/2)], &pairs[2*p[k]], 2);
+                line[ascii+k] = (p[k]>=32 && p[k]<127) ? p[k] : '.';
+            }
+            line[ascii+n]='|';
+            len = ascii+n+1;
+            
+            //--the byte under the cursor is also shown inverted in the text column
+            int mark = (E.hex.cur>=off && E.hex.cur<off+n) ? ascii + (int)(E.hex.cur-off) : -1;
+            int cols = E.screencols;
+            if(mark==-1 || mark>=cols){
+                abAppend(ab, line, len<cols ? len : cols);
+            }else{
+                abAppend(ab, line, mark);
+                abAppend(ab, "\x1b[7m", 4);
+                abAppend(ab, &line[mark], 1);
+                abAppend(ab, "\x1b[m", 3);
+                if(mark+1 < len && mark+1 < cols)
+                    abAppend(ab, &line[mark+1], (len<cols ? len : cols)-mark-1);
+            }
+        }
+        abAppend(ab, "\x1b[K", 3);
+        if(y<E.screenrows-1) abAppend(ab, "\r\n", 2);
+    }
+}
+
+void editorHexGoto(){
+    char *query = editorPrompt("Go to offset: %s (0x for hex, ESC to cancel)", NULL);
+    if(query==NULL) return;
+    unsigned long long off = strtoull(query, NULL, 0);
+    free(query);
+    E.hex.cur = off < E.hex.size ? off : E.hex.size-1; //--the scroll follows, O(1)
+}
+
+void editorHexFind(){
+    char *query = editorPrompt("Find bytes: %s (ESC to cancel)", NULL);
+    if(query==NULL) return;
+    size_t n=strlen(query);
+    const unsigned char *p=E.hex.map+E.hex.cur+1, *end=E.hex.map+E.hex.size;
+    while(p+n <= end && (p = memchr(p, query[0], end-p-n+1)) != NULL){
+        if(!memcmp(p, query, n)) break;
+        p++;
+    }
+    if(p && p+n <= end) E.hex.cur = p-E.hex.map;
+    else editorSetStatusMessage("Not found after %zx: %s", E.hex.cur, query);
+    free(query);
+}
+
+/*
+ -->the keys of the hex view; returns 0 for the ones the front end handles
+    as usual (quit, buffers, reports)
+ */
+int editorHexKey(int c){
+    if(!E.hex.on) return 0;
+    size_t page=(size_t)E.screenrows*KILO_HEX_WIDTH;
+    size_t last=E.hex.size-1;
+    size_t *cur=&E.hex.cur;
+    switch(c){
+        case ARROW_LEFT: if(*cur>0) (*cur)--; break;
+        case ARROW_RIGHT: if(*cur<last) (*cur)++; break;
+        case ARROW_UP: if(*cur>=KILO_HEX_WIDTH) *cur-=KILO_HEX_WIDTH; break;
+        case ARROW_DOWN: if(last-*cur>=KILO_HEX_WIDTH) *cur+=KILO_HEX_WIDTH; break;
+        case PAGE_UP:
+            *cur = *cur>page ? *cur-page : 0;
+            E.hex.top = E.hex.top>page ? E.hex.top-page : 0;
+            break;
+        case PAGE_DOWN:
+            *cur = last-*cur>page ? *cur+page : last;
+            if(E.hex.size-E.hex.top > 2*page) E.hex.top+=page;
+            break;
+        case HOME_KEY: *cur -= *cur%KILO_HEX_WIDTH; break;
+        case END_KEY:
+            *cur += KILO_HEX_WIDTH-1 - *cur%KILO_HEX_WIDTH;
+            if(*cur>last) *cur=last;
+            break;
+        case CTRL_KEY('g'): editorHexGoto(); break;
+        case FIND_KEY: editorHexFind(); break;
+        case SHIFT_Q('Q'): case CTRL_KEY('o'): case CTRL_KEY('n'): case CTRL_KEY('w'):
+        case CTRL_KEY('p'): case CTRL_KEY('e'): case CTRL_KEY('a'): case CTRL_KEY('l'): case '\x1b':
+            return 0;
+        default:
+            editorSetStatusMessage("The hex view is read only");
+            break;
+    }
+    return 1;
+}
+
+/* grep */
+
+struct grepTask{
+    char *path;
+    int dir;
+};
+
+struct grepQueue{ //--[head, n) of task; the owner works at n, thieves take from head
+    struct grepTask *task;
+    int head, n, cap;
+    pthread_mutex_t lock;
+};
+
+struct grepPool{
+    const char *query;
+    size_t qlen;
+    struct grepQueue q[KILO_INDEX_THREADS];
+    int nw;
+    int pending; //--tasks queued or being worked on, 0 means all is done
+    int queued; //--tasks in the queues, idle workers sleep while it is 0
+    int running; //--workers that haven't returned
+    int cancel; //--ESC: the tasks left are dropped
+    pthread_mutex_t lock; //--pending, queued, running, cancel, out and the counts
+    pthread_cond_t work; //--idle workers wait here for a push or the end
+    pthread_cond_t cond; //--the editor waits here for results or the end
+    char *out; //--result lines the buffer hasn't taken yet
+    size_t outlen, outcap;
+    long long files, bytes;
+    int matches;
+};
+
+struct grepWorker{
+    struct grepPool *pool;
+    int id;
+    char *buf; //--small files are read into it
+    size_t cap;
+    pthread_t tid;
+};
+
+void editorGrepPush(struct grepPool *g, int id, char *path, int dir){
+    pthread_mutex_lock(&g->lock); //--held throughout so no idle worker misses the task
+    g->pending++;
+    g->queued++;
+    struct grepQueue *q=&g->q[id];
+    pthread_mutex_lock(&q->lock);
+    if(q->head==q->n) q->head=q->n=0;
+    if(q->n==q->cap){
+        if(q->head){ //--room at the front that thieves left
+            memmove(q->task, &q->task[q->head], sizeof(struct grepTask)*(q->n-q->head));
+            q->n-=q->head;
+            q->head=0;
+        }else{
+            q->cap = q->cap ? q->cap*2 : 64;
+            q->task = realloc(q->task, sizeof(struct grepTask)*q->cap);
+        }
+    }
+    q->task[q->n].path=path;
+    q->task[q->n++].dir=dir;
+    pthread_mutex_unlock(&q->lock);
+    pthread_cond_signal(&g->work);
+    pthread_mutex_unlock(&g->lock);
+}
+
+/*
+ -->the newest task of the worker's own queue (depth first, its files stay
+    warm), else the oldest of another one, which is the biggest share of
+    the tree it has left
+ */
+int editorGrepTake(struct grepPool *g, int id, struct grepTask *t){
+    for(int k=0; k<g->nw; k++){
+        struct grepQueue *q=&g->q[(id+k) % g->nw];
+        pthread_mutex_lock(&q->lock);
+        int got = q->head < q->n;
+        if(got) *t = k==0 ? q->task[--q->n] : q->task[q->head++];
+        pthread_mutex_unlock(&q->lock);
+        if(got){
+            pthread_mutex_lock(&g->lock);
+            g->queued--;
+            pthread_mutex_unlock(&g->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void editorGrepDir(struct grepPool *g, int id, const char *path){
+    DIR *d=opendir(path);
+    if(!d) return;
+    struct dirent *de;
+    while((de = readdir(d)) != NULL && !__atomic_load_n(&g->cancel, __ATOMIC_RELAXED)){
+        if(de->d_name[0]=='.') continue; //--., .. and hidden ones like .git
+        size_t len=strlen(path)+strlen(de->d_name)+2;
+        char *sub=malloc(len);
+        if(!strcmp(path, ".")) snprintf(sub, len, "%s", de->d_name);
+        else snprintf(sub, len, "%s/%s", path, de->d_name);
+        int type=de->d_type;
+        if(type==DT_UNKNOWN){
+            struct stat st;
+            type = lstat(sub, &st)==-1 ? DT_UNKNOWN : S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if(type==DT_DIR || type==DT_REG) editorGrepPush(g, id, sub, type==DT_DIR);
+        else free(sub); //--links are not followed, nor devices and the like
+    }
+    closedir(d);
+}
+
+/*
+ -->collects the lines of one file that contain the query as path:line:
+    text, numbering lines only between one match and the next
+ */
+void editorGrepFile(struct grepWorker *w, const char *path){
+    struct grepPool *g=w->pool;
+    int fd=open(path, O_RDONLY);
+    if(fd==-1) return;
+    struct stat st;
+    char *map=MAP_FAILED;
+    size_t size=0;
+    if(fstat(fd, &st)!=-1 && st.st_size>0){
+        size=st.st_size;
+        if(size >= KILO_INDEX_BLOCK){
+            map=mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(map!=MAP_FAILED) madvise(map, size, MADV_SEQUENTIAL);
+        }else{ //--for small files a read costs less than setting up a mapping
+            if(size > w->cap){
+                w->cap=KILO_INDEX_BLOCK;
+                w->buf=realloc(w->buf, w->cap);
+            }
+            if(read(fd, w->buf, size)==(ssize_t)size) map=w->buf;
+        }
+    }
+    close(fd);
+    if(map==MAP_FAILED) return;
+    
+    struct abuf ab=ABUF_INIT;
+    int matches=0;
+    if(!editorHexDetect(map, size)){
+        const char *p=map, *end=map+size, *counted=map;
+        int line=1;
+        const char *m;
+        while(p<end && (m = memmem(p, end-p, g->query, g->qlen)) != NULL){
+            const char *start=m;
+            while(start>p && start[-1]!='\n') start--;
+            for(const char *nl; counted<start && (nl = memchr(counted, '\n', start-counted)) != NULL; counted=nl+1)
+                line++;
+            counted=start;
+            const char *eol=memchr(m, '\n', end-m);
+            if(!eol) eol=end;
+            
+            char head[64];
+            int hlen=snprintf(head, sizeof(head), ":%d: ", line);
+            size_t tlen=eol-start;
+            if(tlen>KILO_GREP_LINE) tlen=KILO_GREP_LINE;
+            while(tlen>0 && start[tlen-1]=='\r') tlen--;
+            abAppend(&ab, path, strlen(path));
+            abAppend(&ab, head, hlen);
+            abAppend(&ab, start, tlen);
+            abAppend(&ab, "\n", 1);
+            matches++;
+            p=eol+1; //--a line is listed once however many times it matches
+        }
+    }
+    if(map!=w->buf) munmap(map, size);
+    
+    pthread_mutex_lock(&g->lock);
+    g->files++;
+    g->bytes+=size;
+    g->matches+=matches;
+    if(ab.len){
+        if(g->outlen+ab.len > g->outcap){
+            g->outcap = 2*(g->outlen+ab.len);
+            g->out = realloc(g->out, g->outcap);
+        }
+        memcpy(&g->out[g->outlen], ab.b, ab.len);
+        g->outlen+=ab.len;
+        pthread_cond_broadcast(&g->cond);
+    }
+    pthread_mutex_unlock(&g->lock);
+    abFree(&ab);
+}
+
+void *editorGrepRun(void *arg){
+    struct grepWorker *w=arg;
+    struct grepPool *g=w->pool;
+    for(;;){
+        struct grepTask t;
+        if(editorGrepTake(g, w->id, &t)){
+            if(__atomic_load_n(&g->cancel, __ATOMIC_RELAXED)) ; //--only emptying the queues
+            else if(t.dir) editorGrepDir(g, w->id, t.path);
+            else editorGrepFile(w, t.path);
+            free(t.path);
+            pthread_mutex_lock(&g->lock);
+            if(--g->pending==0) pthread_cond_broadcast(&g->work);
+            pthread_mutex_unlock(&g->lock);
+            continue;
+        }
+        //--nothing to take: wait for a push, unless everything is done
+        pthread_mutex_lock(&g->lock);
+        while(g->queued<=0 && g->pending>0) pthread_cond_wait(&g->work, &g->lock);
+        if(g->pending==0){
+            g->running--;
+            pthread_cond_broadcast(&g->cond);
+            pthread_mutex_unlock(&g->lock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&g->lock);
+    }
+}
+
+/*
+ -->the results so far go into E as rows; called with the pool locked,
+    the workers go on meanwhile
+ */
+void editorGrepTakeResults(struct grepPool *g){
+    size_t len=g->outlen;
+    char *buf=g->out;
+    g->out=NULL;
+    g->outlen=g->outcap=0;
+    pthread_mutex_unlock(&g->lock);
+    lineIndex li;
+    editorIndexBuild(&li, buf, len);
+    editorIndexLoadRows(&li, buf, len, NULL, NULL);
+    free(li.start);
+    free(buf);
+    pthread_mutex_lock(&g->lock);
+}
+
+/*
+ -->searches every file under the current directory for the query with a
+    pool of work stealing threads. Results stream into a buffer of their
+    own as they are found, one file:line: text row per matching line; the
+    screen shows them every KILO_GREP_DRAW_MS and ESC stops the search.
+ */
+void editorGrep(){
+    char *query=editorPrompt("Grep: %s (ESC to cancel)", NULL);
+    if(query==NULL) return;
+    long long t=editorMonotonicMs();
+    
+    if(E.locations && !E.dirty) editorCloseFile(); //--a new search replaces the old results
+    else editorBufferNew();
+    E.locations=1;
+    E.journal.suspended=1;
+    E.undo.suspended=1;
+    
+    struct grepPool g;
+    memset(&g, 0, sizeof(g));
+    g.query=query;
+    g.qlen=strlen(query);
+    g.nw=editorIndexWorkers((size_t)KILO_INDEX_BLOCK*KILO_INDEX_THREADS);
+    g.running=g.nw;
+    pthread_mutex_init(&g.lock, NULL);
+    pthread_cond_init(&g.work, NULL);
+    pthread_cond_init(&g.cond, NULL);
+    for(int k=0; k<g.nw; k++) pthread_mutex_init(&g.q[k].lock, NULL);
+    editorGrepPush(&g, 0, strdup("."), 1);
+    
+    struct grepWorker w[KILO_INDEX_THREADS];
+    for(int k=0; k<g.nw; k++){
+        w[k].pool=&g;
+        w[k].id=k;
+        w[k].buf=NULL;
+        w[k].cap=0;
+        if(pthread_create(&w[k].tid, NULL, editorGrepRun, &w[k]) != 0) die("pthread_create");
+    }
+    long long drawn=t;
+    pthread_mutex_lock(&g.lock);
+    while(g.running || g.outlen){
+        if(g.outlen) editorGrepTakeResults(&g);
+        else{
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts); //--the clock timed waits count in
+            ts.tv_nsec += KILO_GREP_DRAW_MS*1000000L;
+            ts.tv_sec += ts.tv_nsec/1000000000L;
+            ts.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&g.cond, &g.lock, &ts);
+        }
+        if(g.running && !g.cancel && editorMonotonicMs()-drawn >= KILO_GREP_DRAW_MS){
+            editorSetStatusMessage("Grep: %d lines in %lld files so far (ESC to stop)", g.matches, g.files);
+            pthread_mutex_unlock(&g.lock);
+            int stop=editorProgress();
+            pthread_mutex_lock(&g.lock);
+            if(stop) __atomic_store_n(&g.cancel, 1, __ATOMIC_RELAXED);
+            drawn=editorMonotonicMs();
+        }
+    }
+    pthread_mutex_unlock(&g.lock);
+    for(int k=0; k<g.nw; k++){
+        pthread_join(w[k].tid, NULL);
+        free(w[k].buf);
+        pthread_mutex_destroy(&g.q[k].lock);
+        free(g.q[k].task);
+    }
+    pthread_mutex_destroy(&g.lock);
+    pthread_cond_destroy(&g.work);
+    pthread_cond_destroy(&g.cond);
+    
+    E.journal.suspended=0;
+    E.undo.suspended=0;
+    E.dirty=0;
+    E.cy=E.cx=0;
+    editorSetStatusMessage("%d lines match \"%s\" in %lld files, %lld MB (%lld ms%s), ENTER opens one",
+                           g.matches, query, g.files, g.bytes>>20, editorMonotonicMs()-t,
+                           g.cancel ? ", stopped" : "");
+    free(query);
+}
+
+/*
+ -->opens the file of the result row under the cursor at its line
+ */
+void editorGrepJump(){
+    if(E.cy >= E.numrows) return;
+    char *s=E.row[E.cy].chars, *p=s;
+    char *end;
+    long line=0;
+    for(;;){ //--the first :number: ends the path, names may hold colons too
+        p=strchr(p, ':');
+        if(!p) return;
+        line=strtol(p+1, &end, 10);
+        if(end>p+1 && *end==':') break;
+        p++;
+    }
+    char *path=strndup(s, p-s);
+    if(editorBufferOpen(path)==-1){
+        editorSetStatusMessage("Can't open %s: %s", path, strerror(errno));
+    }else{
+        E.cy = line-1 < E.numrows ? line-1 : E.numrows;
+        if(E.cy<0) E.cy=0;
+        E.cx=0;
+    }
+    free(path);
+}
+
+/*abbend buffer*/
+
+void abAppend(struct abuf *ab, const char *s, int len){
+    char *new = realloc(ab->b, ab->len + len);
+    
+    if(new==NULL) return;
+    memcpy(&new[ab->len], s, len);
+    ab->b=new;
+    ab->len+=len;
+}
+
+void abFree(struct abuf *ab){
+    free(ab->b);
+}
+
+/*** output ***/
+
+void editorScroll(){
+    if(E.hex.on){
+        editorHexScroll();
+        return;
+    }
+    E.rx=0;
+    if(E.cy<E.numrows){
+        E.rx=editorRowCxToRx(&E.row[E.cy], E.cx);
+    }
+    
+    if(editorViewIndexed()){
+        editorViewScroll();
+        return;
+    }
+    if(E.cy < E.rowoff){
+        E.rowoff=E.cy;
+    }
+    if(E.cy>=E.rowoff+E.screenrows){
+        E.rowoff = E.cy- E.screenrows + 1;
+    }
+    if(E.rx < E.coloff){
+        E.coloff = E.rx;
+    }
+    if(E.rx >=E.coloff + editorTextCols()){
+        E.coloff = E.rx - editorTextCols()+1;
+    }
+}
+
+/*
+ -->len columns of a row's render from start on, in the colors of its hl
+ */
+void editorDrawSpan(struct abuf *ab, erow *row, int start, int len){
+    editorRowEnsureDerived(row);
+    int match = (E.brackets.match && row->idx==E.brackets.mrow) ? E.brackets.mrx-start : -1;
+    char *c = &row->render[start];
+    unsigned char *hl = &row->hl[start];
+    int current_color=-1;
+    int j;
+    for(j=0;j<len; j++){
+        if(j==match){ //--the partner of the bracket at the cursor, inverted
+            abAppend(ab, "\x1b[7m", 4);
+            abAppend(ab, &c[j], 1);
+            abAppend(ab, "\x1b[27m", 5);
+            continue;
+        }
+        //if is a control character
+        if(iscntrl(c[j])){
+            char sym= (c[j]<=26) ? '@' + c[j] : '?'; //--in ascii, the capital letter
+            //comes after @
+            abAppend(ab, "\x1b[7m", 4); //--switch to inverted colors
+            abAppend(ab, &sym, 1);
+            abAppend(ab, "\x1b[m", 3); //--turn off inverted colors again
+            if(current_color !=-1){
+                char buf[16];
+                int clen = snprintf ( buf, sizeof(buf), "\x1b[%dm", current_color);
+                abAppend(ab, buf, clen);
+            }
+        }else if(hl[j]==HL_NORMAL){
+            if(current_color!=-1){
+                abAppend(ab, "\x1b[39m", 5);
+                current_color=-1;}
+            abAppend(ab, &c[j], 1);
+        }else{
+            int color= editorSyntaxToColor(hl[j]);
+            if(color!=current_color){
+                current_color= color;
+                char buf[16];
+                int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
+                abAppend(ab, buf, clen);
+            }
+            abAppend(ab, &c[j], 1);
+        }
+    }
+    abAppend(ab, "\x1b[39m", 5);
+}
+
+/*
+ -->a closed fold shows as its first row with a marker after the text
+ */
+void editorDrawFoldMarker(struct abuf *ab, int filerow, int len){
+    if(!E.view.nfolds || editorFoldAt(filerow)==-1) return;
+    if(len+4 > editorTextCols()) return;
+    abAppend(ab, " \x1b[7m...\x1b[m", 11);
+}
+
+void editorDrawRows(struct abuf *ab){
+    long long t = LATENCY_BEGIN();
+    if(E.hex.on){
+        editorHexDrawRows(ab);
+        LATENCY_END(PROBE_DRAW_ROWS, t);
+        return;
+    }
+    int y;
+    int filerow = E.rowoff;
+    int seg = E.view.wrap ? E.view.segoff : 0; //--display line of filerow, wrapped
+    int cols = editorTextCols();
+    for(y=0; y<E.screenrows; y++){
+        if(E.view.nfolds && filerow<E.numrows && E.row[filerow].hidden)
+            filerow = editorViewFind(editorViewPrefix(filerow), &seg); //--over a closed fold
+        if(filerow >= E.numrows){ //if we draw a new row
+            if(E.numrows==0 && y==E.screenrows/3){
+                char welcome[80];
+                int welcomelen = snprintf(welcome, sizeof(welcome),
+                                         "KILO -- version %s", KILO_VERSION);
+                if(welcomelen > E.screencols) welcomelen=E.screencols;
+                int padding = (E.screencols-welcomelen)/2;
+                if(padding){
+                    abAppend(ab, "~", 1);
+                    padding--;
+                }
+                while(padding--) abAppend(ab, " ", 1);
+                abAppend(ab, welcome, welcomelen);
+            } else{
+                abAppend(ab, "~", 1);
+            }
+            filerow++;
+        } else if(E.view.wrap){ //--the next screen wide piece of the row
+            erow *row = &E.row[filerow];
+            editorDrawGutter(ab, filerow, seg==0);
+            int start = seg*cols;
+            int len = row->rsize - start;
+            if(len>cols) len=cols;
+            if(len<0) len=0;
+            editorDrawSpan(ab, row, start, len);
+            if(++seg >= editorWrapSegs(row->rsize)){
+                editorDrawFoldMarker(ab, filerow, len);
+                seg=0;
+                filerow++;
+            }
+        } else{ // if we draw a row that is part of the text buffer
+            editorDrawGutter(ab, filerow, 1);
+            int len= E.row[filerow].rsize - E.coloff;
+            if(len<0) len =0;
+            if(len>cols) len=cols;
+            editorDrawSpan(ab, &E.row[filerow], E.coloff, len);
+            editorDrawFoldMarker(ab, filerow, len);
+            filerow++;
+        }
+        
+        abAppend(ab, "\x1b[K", 3);
+        if(y<E.screenrows-1){
+            abAppend(ab, "\r\n", 2);
+        }
+    }
+    LATENCY_END(PROBE_DRAW_ROWS, t);
+}
+
+void editorDrawStatusBar(struct abuf *ab){
+    abAppend(ab, "\x1b[7m", 4); // text will be printed with inverted colors
+    if(E.latency.overlay){
+        char lat[256];
+        int llen = editorLatencyOverlay(lat, sizeof(lat));
+        if(llen > E.screencols) llen = E.screencols;
+        abAppend(ab, lat, llen);
+        while(llen++ < E.screencols) abAppend(ab, " ", 1);
+        abAppend(ab, "\x1b[m", 3);
+        abAppend(ab, "\r\n", 2);
+        return;
+    }
+    char status[80], rstatus[80];
+    int len, rlen;
+    if(E.hex.on){
+        len = snprintf(status, sizeof(status), "%.20s- %zu bytes", E.filename, E.hex.size);
+        rlen = snprintf(rstatus, sizeof(rstatus), "hex | %zx/%zx", E.hex.cur, E.hex.size);
+    }else{
+        len = snprintf(status, sizeof(status), "%.20s- %d lines %s",
+                       E.filename ? E.filename : "[No Name]", E.numrows,
+                       E.dirty ? "modified": "");
+        rlen= snprintf(rstatus, sizeof(rstatus), "%s | %d/%d",
+                       E.syntax ? E.syntax->filetype : "no ft" ,E.cy+1, E.numrows);
+    }
+    if(E.nbuffers>1)
+        rlen+= snprintf(rstatus+rlen, sizeof(rstatus)-rlen, " | buf %d/%d", E.current+1, E.nbuffers);
+    if(len > E.screencols) len= E.screencols;
+    abAppend(ab, status, len);
+    while(len < E.screencols){
+        if(E.screencols - len == rlen){
+            abAppend(ab, rstatus, rlen);
+            break;
+        }else{
+            abAppend(ab, " ", 1);
+            len++;
+        }
+    }
+    abAppend(ab, "\x1b[m", 3); // text back to normal
+    abAppend(ab, "\r\n", 2);
+}
+
+void editorDrawMessageBar(struct abuf *ab){
+    abAppend(ab, "\x1b[K", 3);
+    int msglen = strlen(E.statusmsg);
+    if(msglen > E.screencols) msglen = E.screencols;
+    if(msglen && time(NULL)-E.statusmsg_time<5)
+        abAppend(ab, E.statusmsg, msglen);
+}
+
+/*
+ -->builds a whole frame into ab; writing it out is up to the front end
+ */
+void editorDrawFrame(struct abuf *ab){
+    editorScroll();
+    editorMemEnforce(); //--knows what is on screen only after the scroll
+    
+    abAppend(ab, "\x1b[?25l", 6);
+    //abAppend(ab, "\x1b[2J", 4); //not required anymore, cleaning 1 row at the time
+    abAppend(ab, "\x1b[H", 3);
+    
+    if(E.diff.on && E.diff.stale) editorDiffUpdate();
+    editorBracketUpdateMatch();
+    editorDrawRows(ab);
+    editorDrawStatusBar(ab);
+    editorDrawMessageBar(ab);
+    
+    char buf[32];
+    int y, x;
+    editorCursorOnScreen(&y, &x);
+    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y+1, x+1);
+    abAppend(ab, buf, strlen(buf));
+    
+    abAppend(ab, "\x1b[?25h", 6);
+}
+
+/*
+ -->splits frame text into terminal lines (what lies between the \r\n) and
+    records them in lines; the ones that differ from what lines held go into
+    ab, all of them after a clear when the count differs. With ab NULL the
+    lines are only recorded, for a screen written some other way.
+ */
+void editorDrawFrameLines(struct abuf *ab, const char *text, int len, struct abuf **lines, int *nlines){
+    int n=1;
+    for(int j=0; j+1<len; j++)
+        if(text[j]=='\r' && text[j+1]=='\n') n++;
+    
+    if(n != *nlines){
+        editorDrawFrameForget(lines, nlines);
+        *lines = malloc(sizeof(struct abuf)*n);
+        for(int y=0; y<n; y++) (*lines)[y].b=NULL, (*lines)[y].len=-1;
+        *nlines = n;
+        editorMemAdd(MEM_OUTPUT, (long long)sizeof(struct abuf)*n);
+        if(ab) abAppend(ab, "\x1b[2J", 4);
+    }
+    
+    char buf[32];
+    int start=0;
+    for(int y=0; y<n; y++){
+        int end=start;
+        while(end<len && !(end+1<len && text[end]=='\r' && text[end+1]=='\n')) end++;
+        if(end>len) end=len;
+        int llen=end-start;
+        struct abuf *old=&(*lines)[y];
+        if(old->len!=llen || memcmp(old->b, &text[start], llen)){
+            if(ab){
+                snprintf(buf, sizeof(buf), "\x1b[%d;1H", y+1);
+                abAppend(ab, buf, strlen(buf));
+                abAppend(ab, &text[start], llen);
+            }
+            editorMemAdd(MEM_OUTPUT, llen - (old->len>0 ? old->len : 0));
+            free(old->b);
+            old->b=malloc(llen ? llen : 1);
+            memcpy(old->b, &text[start], llen);
+            old->len=llen;
+        }
+        start=end+2;
+    }
+}
+
+/*
+ -->like editorDrawFrame, but only the terminal lines that differ from the
+    previous frame in lines are put into ab; lines is updated to this frame.
+    A frame of another height is drawn in full.
+ */
+void editorDrawFrameDiff(struct abuf *ab, struct abuf **lines, int *nlines){
+    editorScroll();
+    editorMemEnforce();
+    
+    struct abuf frame = ABUF_INIT;
+    if(E.diff.on && E.diff.stale) editorDiffUpdate();
+    editorBracketUpdateMatch();
+    editorDrawRows(&frame);
+    editorDrawStatusBar(&frame);
+    editorDrawMessageBar(&frame);
+    
+    abAppend(ab, "\x1b[?25l", 6);
+    editorDrawFrameLines(ab, frame.b, frame.len, lines, nlines);
+    abFree(&frame);
+    
+    char buf[32];
+    int cy, cx;
+    editorCursorOnScreen(&cy, &cx);
+    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", cy+1, cx+1);
+    abAppend(ab, buf, strlen(buf));
+    abAppend(ab, "\x1b[?25h", 6);
+}
+
+/*
+ -->lines becomes what a frame of editorDrawFrame puts on the screen, so the
+    next diff goes on from it instead of redrawing everything
+ */
+void editorDrawFrameSeed(const struct abuf *frame, struct abuf **lines, int *nlines){
+    static const char head[]="\x1b[?25l\x1b[H", tail[]="\x1b[?25h";
+    int hlen=sizeof(head)-1, tlen=sizeof(tail)-1;
+    int end=frame->len-tlen;
+    if(end<hlen || memcmp(frame->b, head, hlen) || memcmp(frame->b+end, tail, tlen)){
+        editorDrawFrameForget(lines, nlines);
+        return;
+    }
+    while(end>hlen && frame->b[--end]!='\x1b') ; //--the cursor position ends the text
+    editorDrawFrameLines(NULL, frame->b+hlen, end-hlen, lines, nlines);
+}
+
+/*
+ -->drops the lines a diff is made against, the next frame is drawn in full
+ */
+void editorDrawFrameForget(struct abuf **lines, int *nlines){
+    long long bytes=(long long)sizeof(struct abuf)* *nlines;
+    for(int y=0; y<*nlines; y++){
+        if((*lines)[y].len>0) bytes+=(*lines)[y].len;
+        abFree(&(*lines)[y]);
+    }
+    free(*lines);
+    *lines=NULL;
+    *nlines=0;
+    editorMemAdd(MEM_OUTPUT, -bytes);
+}
+
+void editorSetStatusMessage(const char *fmt, ...){
+    va_list ap;
+    va_start (ap, fmt);
+    vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
+    va_end(ap);
+    E.statusmsg_time= time(NULL);
+} //variadic function
+
+/*** init ***/
+
+void initEditor(){
+    editorBufferReset();
+    E.statusmsg[0]='\0';
+    E.statusmsg_time=0;
+    E.buffers=NULL;
+    E.nbuffers=0;
+    E.current=0;
+    memset(&E.latency, 0, sizeof(E.latency));
+    memset(&E.mem, 0, sizeof(E.mem));
+    
+    E.screenrows=24-2; //--until the front end knows the real size
+    E.screencols=80;
+}